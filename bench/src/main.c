@@ -0,0 +1,301 @@
+/* Copyright (c) 2010-2018 the corto developers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* Benchmark for the dependency resolver. Builds and walks synthetic graphs,
+ * and prints one JSON object per graph and size:
+ *
+ *   bench [graph] [maxItems]
+ *
+ * Items are plain memory cells that are named by their index, as the resolver
+ * does not look at items except when reporting errors. All graphs can be
+ * resolved. */
+
+#include <corto.g.bench>
+
+#define BENCH_MIN_TIME (0.5) /* Repeat runs until this many seconds have passed */
+#define BENCH_MAX_RUNS (20)
+#define BENCH_CYCLE_SIZE (8)
+#define BENCH_BRANCHING (4)
+
+typedef void (*bench_build)(
+    corto_depresolver resolver,
+    corto_uint64 *items,
+    corto_uint32 count);
+
+typedef struct bench_graph {
+    const char *name;
+    bench_build build;
+} bench_graph;
+
+/* Each item must be declared after the previous item is defined */
+static
+void bench_chain(
+    corto_depresolver resolver,
+    corto_uint64 *items,
+    corto_uint32 count)
+{
+    corto_uint32 i;
+
+    for (i = 1; i < count; i ++) {
+        corto_depresolver_depend(
+            resolver, &items[i], CORTO_DECLARED, &items[i - 1], CORTO_VALID);
+    }
+}
+
+/* All items depend on the first item, so all items are printed at once */
+static
+void bench_fanout(
+    corto_depresolver resolver,
+    corto_uint64 *items,
+    corto_uint32 count)
+{
+    corto_uint32 i;
+
+    corto_depresolver_insert(resolver, &items[0]);
+    for (i = 1; i < count; i ++) {
+        corto_depresolver_depend(
+            resolver, &items[i], CORTO_DECLARED, &items[0], CORTO_VALID);
+    }
+}
+
+/* Groups of items in which every item has a weak dependency on every other
+ * item, like types that refer to each other */
+static
+void bench_weakCycles(
+    corto_depresolver resolver,
+    corto_uint64 *items,
+    corto_uint32 count)
+{
+    corto_uint32 i, j;
+
+    for (i = 0; i < count; i ++) {
+        corto_uint32 group = i - i % BENCH_CYCLE_SIZE;
+        for (j = group; j < group + BENCH_CYCLE_SIZE && j < count; j ++) {
+            if (j != i) {
+                corto_depresolver_depend(resolver, &items[i], CORTO_VALID,
+                    &items[j], CORTO_DECLARED | CORTO_VALID);
+            }
+        }
+    }
+}
+
+/* Tree of scopes. Items are declared after their parent is declared, and
+ * parents are defined after their children are defined. */
+static
+void bench_hierarchy(
+    corto_depresolver resolver,
+    corto_uint64 *items,
+    corto_uint32 count)
+{
+    corto_uint32 i;
+
+    for (i = 1; i < count; i ++) {
+        corto_uint32 parent = (i - 1) / BENCH_BRANCHING;
+        corto_depresolver_depend(resolver,
+            &items[i], CORTO_DECLARED, &items[parent], CORTO_DECLARED);
+        corto_depresolver_depend(resolver,
+            &items[parent], CORTO_VALID, &items[i], CORTO_VALID);
+    }
+}
+
+/* Scope hierarchy that is as deep as there are items, where each item also
+ * has a weak dependency on its parent. All items are in a single component,
+ * which must be found by a depth first search through all items. Every level
+ * requires breaking a dependency, which are all broken in the same pass. */
+static
+void bench_deepCycle(
+    corto_depresolver resolver,
+    corto_uint64 *items,
+    corto_uint32 count)
+{
+    corto_uint32 i;
+
+    for (i = 1; i < count; i ++) {
+        corto_depresolver_depend(resolver,
+            &items[i], CORTO_DECLARED, &items[i - 1], CORTO_DECLARED);
+        corto_depresolver_depend(resolver,
+            &items[i - 1], CORTO_VALID, &items[i], CORTO_VALID);
+        corto_depresolver_depend(resolver,
+            &items[i], CORTO_VALID, &items[i - 1], CORTO_DECLARED | CORTO_VALID);
+    }
+    if (count > 1) {
+        corto_depresolver_depend(resolver, &items[count - 1], CORTO_VALID,
+            &items[0], CORTO_DECLARED | CORTO_VALID);
+    }
+}
+
+static bench_graph graphs[] = {
+    {"chain", bench_chain},
+    {"fanout", bench_fanout},
+    {"weakCycles", bench_weakCycles},
+    {"hierarchy", bench_hierarchy},
+    {"deepCycle", bench_deepCycle}
+};
+
+static
+int bench_onPrint(
+    corto_object o,
+    void *userData)
+{
+    CORTO_UNUSED(o);
+    (*(corto_uint32*)userData) ++;
+    return 1;
+}
+
+/* Name item by its index in the items of the graph */
+static
+char* bench_name(
+    void *item,
+    void *keyData)
+{
+    return ut_asprintf("item%u",
+        (corto_uint32)((corto_uint64*)item - (corto_uint64*)keyData));
+}
+
+static
+double bench_elapsed(
+    struct timespec *start)
+{
+    struct timespec now;
+    ut_time_get(&now);
+    return ut_time_to_double(ut_time_sub(now, *start));
+}
+
+/* Build and walk graph, report fastest of runs */
+static
+int bench_run(
+    bench_graph *graph,
+    corto_uint32 count)
+{
+    corto_uint64 *items = corto_calloc(count * sizeof(corto_uint64));
+    corto_depresolver_opt opt;
+    corto_depresolver_stats_t stats;
+    corto_depresolver_analysis_t analysis;
+    double build = 0, walk = 0, total = 0;
+    corto_uint32 edges = 0, printed = 0, run;
+    size_t resolverBytes = 0;
+
+    /* Items are not objects, so the resolver must not treat them as such */
+    corto_depresolver_opt_init(&opt);
+    opt.onDeclare = bench_onPrint;
+    opt.onDefine = bench_onPrint;
+    opt.userData = &printed;
+    opt.name = bench_name;
+    opt.keyData = items;
+
+    memset(&analysis, 0, sizeof(analysis));
+    for (run = 0; run < BENCH_MAX_RUNS && total < BENCH_MIN_TIME; run ++) {
+        corto_depresolver resolver;
+        struct timespec start;
+        double t;
+
+        printed = 0;
+        ut_time_get(&start);
+        resolver = corto_depresolverCreateGeneric(&opt);
+        graph->build(resolver, items, count);
+        corto_depresolver_freeze(resolver);
+        t = bench_elapsed(&start);
+        total += t;
+        if (!run || t < build) {
+            build = t;
+        }
+
+        ut_time_get(&start);
+        if (corto_depresolver_walk(resolver)) {
+            ut_error("walking '%s' with %u items failed", graph->name, count);
+            corto_depresolver_free(resolver);
+            goto error;
+        }
+        t = bench_elapsed(&start);
+        total += t;
+        if (!run || t < walk) {
+            walk = t;
+        }
+
+        /* Memory counters are high-water marks of the resolver. Memory of the
+         * process is not reported, as it includes earlier graphs. */
+        corto_depresolver_stats(resolver, &stats);
+        edges = stats.declareEdges + stats.defineEdges;
+        resolverBytes = stats.arenaReserved + stats.indexBytes +
+            stats.graphBytes + stats.stackBytes;
+
+        /* Parallelism does not depend on the run, so only analyze once */
+        if (!run) {
+            corto_depresolver_analyze(resolver, NULL, NULL, &analysis);
+        }
+        corto_depresolver_free(resolver);
+    }
+
+    if (printed != 2 * count) {
+        ut_error("walking '%s' with %u items printed %u of %u items",
+            graph->name, count, printed, 2 * count);
+        goto error;
+    }
+
+    printf("{\"graph\":\"%s\",\"items\":%u,\"edges\":%u,\"runs\":%u,"
+        "\"buildNsPerEdge\":%.2f,\"walkNsPerEdge\":%.2f,\"nsPerEdge\":%.2f,"
+        "\"resolverBytes\":%zu,"
+        "\"depth\":%u,\"maxWidth\":%u,\"parallelism\":%.2f}\n",
+        graph->name,
+        count,
+        edges,
+        run,
+        edges ? build * 1e9 / edges : 0,
+        edges ? walk * 1e9 / edges : 0,
+        edges ? (build + walk) * 1e9 / edges : 0,
+        resolverBytes,
+        analysis.depth,
+        analysis.maxWidth,
+        analysis.parallelism);
+    fflush(stdout);
+    corto_depresolver_analysis_deinit(&analysis);
+
+    corto_dealloc(items);
+    return 0;
+error:
+    corto_depresolver_analysis_deinit(&analysis);
+    corto_dealloc(items);
+    return -1;
+}
+
+int main(int argc, char *argv[]) {
+    const char *filter = argc > 1 ? argv[1] : NULL;
+    corto_uint32 max = argc > 2 ? atoi(argv[2]) : 1000000;
+    corto_uint32 i, count;
+    int result = 0;
+
+    corto_start(argv[0]);
+
+    for (i = 0; i < sizeof(graphs) / sizeof(bench_graph); i ++) {
+        if (filter && strcmp(filter, "all") && strcmp(filter, graphs[i].name)) {
+            continue;
+        }
+        for (count = 1000; count <= max; count *= 10) {
+            if (bench_run(&graphs[i], count)) {
+                result = -1;
+            }
+        }
+    }
+
+    corto_stop();
+
+    return result;
+}
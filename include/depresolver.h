@@ -32,17 +32,111 @@ typedef int (*corto_depresolver_action)(
     corto_object o,
     void *userData);
 
+/* Compare items, returns a negative number if o1 should be printed before o2.
+ * The userData argument is the keyData of the resolver options. */
+typedef int (*corto_depresolver_compare)(
+    corto_object o1,
+    corto_object o2,
+    void *userData);
+
+/* Hash item, for resolvers of items that are not compared by pointer. Items
+ * that are equal must have the same hash. */
+typedef uint32_t (*corto_depresolver_hashAction)(
+    void *item,
+    void *userData);
+
+/* Test if two items are the same item */
+typedef bool (*corto_depresolver_equalsAction)(
+    void *item1,
+    void *item2,
+    void *userData);
+
+/* Get name of item. Returns NULL if the item has no name, otherwise returned
+ * string must be deallocated. */
+typedef char* (*corto_depresolver_nameAction)(
+    void *item,
+    void *userData);
+
+/* Callbacks may be invoked from multiple threads at the same time */
+#define CORTO_DEPRESOLVER_THREADSAFE (1)
+
+/* Break cycles with as few forward declarations as possible, instead of
+ * breaking the weak dependencies of the first items that are found in a
+ * cycle. */
+#define CORTO_DEPRESOLVER_MINIMAL_BREAK (2)
+
+/* Of the items that can be printed, print the first in a stable order instead
+ * of the item that became printable last. Items are ordered with the compare
+ * function in the options, or by name if no function is provided. This makes
+ * the printed sequence independent of the order in which items and
+ * dependencies are added. Items that compare equal, like items without a name
+ * when ordering by name, are printed in insertion order. */
+#define CORTO_DEPRESOLVER_ORDERED (4)
+
+/* Remove dependencies that are implied by other dependencies when freezing
+ * the graph. A dependency is implied if the dependent is already ordered after
+ * the dependency by dependencies that cannot be broken, for example when an
+ * object depends on a type directly and through its parent. This makes the
+ * walked graph smaller, at the cost of a bounded search per dependency. */
+#define CORTO_DEPRESOLVER_REDUCE (8)
+
+/* Options for creating a resolver. Initialize with corto_depresolver_opt_init
+ * so that fields added in later versions get sensible defaults. */
+typedef struct corto_depresolver_opt {
+    corto_depresolver_action onDeclare;
+    corto_depresolver_action onDefine;
+    void *userData;
+    uint32_t capacity; /* Expected number of items, 0 if unknown */
+    uint32_t flags;
+    uint32_t workers; /* Number of threads that print items in parallel. Only
+                       * used if flags include CORTO_DEPRESOLVER_THREADSAFE.
+                       * Threads start on the first walk and stop when the
+                       * resolver is freed. */
+    corto_depresolver_compare compare; /* Order of CORTO_DEPRESOLVER_ORDERED */
+    uint32_t traceSize; /* Number of walk events kept for diagnostics, 0 to
+                         * disable tracing. Rounded up to a power of two. */
+
+    /* Identity of items. Items are hashed and compared by pointer if the
+     * functions are NULL. The name is used for ordering and diagnostics.
+     * Callbacks are only invoked when items and dependencies are added, and
+     * when the graph is frozen. */
+    corto_depresolver_hashAction hash;
+    corto_depresolver_equalsAction equals;
+    corto_depresolver_nameAction name;
+    void *keyData; /* Passed to hash, equals, name and compare */
+    void *root; /* Item that is always declared and defined, if in graph */
+} corto_depresolver_opt;
+
+CORTO_G_EXPORT
+void corto_depresolver_opt_init(
+    corto_depresolver_opt *opt);
+
 CORTO_G_EXPORT
 corto_depresolver corto_depresolverCreate(
     corto_depresolver_action onDeclare,
     corto_depresolver_action onDefine,
     void *userData);
 
+/* Create resolver for corto objects from options. Objects are named by full
+ * path unless the options provide a name function, and the root object is
+ * always declared and defined. */
+CORTO_G_EXPORT
+corto_depresolver corto_depresolverCreateExt(
+    corto_depresolver_opt *opt);
+
+/* Create resolver for items of any kind. The resolver does not make
+ * assumptions about items other than those described by the hash, equals and
+ * name functions of the options. */
+CORTO_G_EXPORT
+corto_depresolver corto_depresolverCreateGeneric(
+    corto_depresolver_opt *opt);
+
 CORTO_G_EXPORT
 void corto_depresolver_insert(
     corto_depresolver _this,
     void *item);
 
+/* Add dependency. Adding a dependency that already exists has no effect. */
 CORTO_G_EXPORT
 void corto_depresolver_depend(
     corto_depresolver _this,
@@ -51,10 +145,219 @@ void corto_depresolver_depend(
     void *dependency,
     corto_state dependencyKind);
 
+/* Dependency, as passed to corto_depresolver_dependBatch */
+typedef struct corto_depresolver_edge {
+    void *dependent;
+    corto_state kind;
+    void *dependency;
+    corto_state dependencyKind;
+} corto_depresolver_edge;
+
+/* Add dependencies in order. Equivalent to calling corto_depresolver_depend
+ * for each edge, but cheaper when subsequent edges have the same dependent. */
+CORTO_G_EXPORT
+void corto_depresolver_dependBatch(
+    corto_depresolver _this,
+    corto_depresolver_edge *edges,
+    uint32_t count);
+
+/* Remove item and all dependencies from and on the item. Items that depended
+ * on the removed item are printed by the next update. */
+CORTO_G_EXPORT
+void corto_depresolver_remove(
+    corto_depresolver _this,
+    void *item);
+
+/* Remove dependency that was added with corto_depresolver_depend. */
+CORTO_G_EXPORT
+void corto_depresolver_undepend(
+    corto_depresolver _this,
+    void *dependent,
+    corto_state kind,
+    void *dependency,
+    corto_state dependencyKind);
+
+/* Replace callbacks. Allows walking the same graph with different callbacks. */
+CORTO_G_EXPORT
+void corto_depresolver_setActions(
+    corto_depresolver _this,
+    corto_depresolver_action onDeclare,
+    corto_depresolver_action onDefine,
+    void *userData);
+
+/* Convert the graph to the compact representation that is used for walking.
+ * Walking freezes the graph if it changed since it was last frozen, so this
+ * only needs to be called to control when the conversion happens. */
+CORTO_G_EXPORT
+void corto_depresolver_freeze(
+    corto_depresolver _this);
+
+/* Walk items in dependency order. Walking does not modify the graph, so a
+ * resolver can be walked more than once. */
 CORTO_G_EXPORT
 int corto_depresolver_walk(
     corto_depresolver _this);
 
+/* Print only items that changed since the last walk, and the items that
+ * depend on them. Items are changed by inserting them, by adding or removing
+ * their dependencies, or by removing an item they depend on. If the last walk
+ * did not succeed, all items are printed. */
+CORTO_G_EXPORT
+int corto_depresolver_update(
+    corto_depresolver _this);
+
+/* Number of forward declarations that are needed to walk a graph. A forward
+ * declaration is needed for each weak dependency that is broken. */
+typedef struct corto_depresolver_plan_t {
+    uint32_t forwardDeclarations; /* With cycle breaking of resolver */
+    uint32_t greedyForwardDeclarations; /* With greedy cycle breaking */
+    uint32_t unresolved; /* Items that cannot be defined */
+} corto_depresolver_plan_t;
+
+/* Determine the number of forward declarations that a walk needs, and compare
+ * it with greedy cycle breaking. Callbacks are not invoked. */
+CORTO_G_EXPORT
+void corto_depresolver_plan(
+    corto_depresolver _this,
+    corto_depresolver_plan_t *plan);
+
+/* Cost of declaring (kind is CORTO_DECLARED) or defining (kind is
+ * CORTO_VALID) an item. Callbacks can measure the time they spend on each
+ * item, so that an analysis uses real timings. */
+typedef double (*corto_depresolver_costAction)(
+    void *item,
+    corto_state kind,
+    void *userData);
+
+/* Parallelism of a graph. A level contains the declares and defines that can
+ * be printed after all declares and defines of previous levels. */
+typedef struct corto_depresolver_analysis_t {
+    uint32_t events; /* Printed declares and defines */
+    uint32_t depth; /* Number of levels, or events in longest chain */
+    uint32_t *width; /* Number of events per level, depth elements */
+    uint32_t maxWidth; /* Number of events in widest level */
+    uint32_t unresolved; /* Items that cannot be defined */
+    double work; /* Cost of all events */
+    double criticalPath; /* Cost of most expensive chain of events */
+    double parallelism; /* Work divided by critical path */
+} corto_depresolver_analysis_t;
+
+/* Determine how parallel a graph is. Cycles are broken as they are by a walk,
+ * and broken dependencies do not count. If costAction is NULL, each declare
+ * and define costs 1. Callbacks of the resolver are not invoked. Deinitialize
+ * the analysis with corto_depresolver_analysis_deinit. */
+CORTO_G_EXPORT
+void corto_depresolver_analyze(
+    corto_depresolver _this,
+    corto_depresolver_costAction costAction,
+    void *userData,
+    corto_depresolver_analysis_t *analysis);
+
+/* Upper bound for the speedup of printing a graph with a number of workers,
+ * compared to a single worker. */
+CORTO_G_EXPORT
+double corto_depresolver_speedup(
+    corto_depresolver_analysis_t *analysis,
+    uint32_t workers);
+
+/* Free resources of analysis */
+CORTO_G_EXPORT
+void corto_depresolver_analysis_deinit(
+    corto_depresolver_analysis_t *analysis);
+
+/* Get item from name, for loading a stored graph. Returns NULL if the item
+ * cannot be found. */
+typedef void* (*corto_depresolver_lookupAction)(
+    const char *name,
+    void *userData);
+
+/* Store items and dependencies of resolver in file. Items are stored by name,
+ * and the key identifies the data from which the graph was built. */
+CORTO_G_EXPORT
+int corto_depresolver_save(
+    corto_depresolver _this,
+    const char *file,
+    uint64_t key,
+    corto_depresolver_nameAction nameAction,
+    void *userData);
+
+/* Add items and dependencies stored with corto_depresolver_save. The file is
+ * mapped in memory, and its items and dependencies are added as if with
+ * corto_depresolver_insert and corto_depresolver_depend, so loading costs
+ * about as much as adding them, but avoids extracting dependencies from the
+ * data the graph was built from. Returns 0 if the graph is loaded, 1 if the
+ * file does not exist or was stored with another key, and -1 if the file is
+ * invalid or an item cannot be found. If loading fails, the resolver may
+ * contain part of the graph. */
+CORTO_G_EXPORT
+int corto_depresolver_load(
+    corto_depresolver _this,
+    const char *file,
+    uint64_t key,
+    corto_depresolver_lookupAction lookupAction,
+    void *userData);
+
+/* Free resolver */
+CORTO_G_EXPORT
+void corto_depresolver_free(
+    corto_depresolver _this);
+
+/* Resolver statistics. Memory counters are high-water marks, as resolver
+ * memory is only released when the resolver is freed. Counters for cycles and
+ * times spent in cycle detection and printing are for the last walk. */
+typedef struct corto_depresolver_stats_t {
+    uint32_t items;
+    uint32_t declareEdges; /* Dependencies that must be resolved before declaring dependent */
+    uint32_t defineEdges; /* Dependencies that must be resolved before defining dependent */
+    uint32_t weakEdges; /* Dependencies on DECLARED | VALID, which may be broken */
+    uint32_t brokenEdges; /* Weak dependencies broken to resolve cycles */
+    uint32_t sccCount; /* Number of strongly connected components with cycles */
+    uint32_t sccMaxSize; /* Number of items in largest component */
+    uint32_t sccItems; /* Number of items in components */
+    double buildTime; /* Seconds between creating resolver and first walk */
+    double freezeTime; /* Seconds spent freezing graph */
+    double cycleTime; /* Seconds spent detecting and breaking cycles */
+    double emitTime; /* Seconds spent printing items, including callbacks */
+    size_t arenaReserved; /* Bytes allocated for items and dependencies */
+    size_t arenaUsed; /* Bytes used by items and dependencies */
+    uint32_t arenaChunks;
+    size_t indexBytes; /* Bytes used by item and dependency index */
+    size_t graphBytes; /* Bytes used by frozen graph */
+    size_t stackBytes; /* Bytes used by print and cycle detection stacks */
+    uint32_t duplicates; /* Number of ignored duplicate dependencies */
+    uint32_t reducedEdges; /* Implied dependencies removed from frozen graph */
+} corto_depresolver_stats_t;
+
+/* Get resolver statistics */
+CORTO_G_EXPORT
+void corto_depresolver_stats(
+    corto_depresolver _this,
+    corto_depresolver_stats_t *stats);
+
+/* Export graph in DOT format. Edges point from dependency to dependent, weak
+ * dependencies are dashed. Dependencies broken by the last walk and items that
+ * could not be defined are red. Items are labeled with the positions of their
+ * declare and define in the sequence printed by the resolver, or 0 if they
+ * were not printed. Returned string must be deallocated. */
+CORTO_G_EXPORT
+char* corto_depresolver_toDot(
+    corto_depresolver _this);
+
+/* Export graph in JSON format, with the same information as the DOT export.
+ * Returned string must be deallocated. */
+CORTO_G_EXPORT
+char* corto_depresolver_toJson(
+    corto_depresolver _this);
+
+/* Convert the most recent events of the last walk to a string, one event per
+ * line. Events refer to items in the graph of the walk, so the resolver should
+ * not be modified before calling this function. The trace is also reported
+ * when a walk fails. Returns NULL if tracing is disabled, otherwise returned
+ * string must be deallocated. */
+CORTO_G_EXPORT
+char* corto_depresolver_traceStr(
+    corto_depresolver _this);
+
 #ifdef __cplusplus
 }
 #endif
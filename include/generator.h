@@ -28,6 +28,15 @@ extern "C" {
 
 typedef struct g_generator_s* g_generator;
 
+/* Table of anonymous objects, see g_anonymousIntern */
+typedef struct g_anonymousTable g_anonymousTable;
+
+/* Cache of g_mustParse verdicts */
+typedef struct g_parseCache g_parseCache;
+
+/* Order of objects cached by g_walkAll */
+typedef struct g_walkOrder g_walkOrder;
+
 typedef
 int (*g_walkAction)(
     corto_object o,
@@ -81,7 +90,9 @@ struct g_generator_s {
     g_object* current;
     corto_object package;
     bool inWalk;
-    ut_ll anonymousObjects;
+    g_anonymousTable *anonymousObjects;
+    g_parseCache *parseCache;
+    g_walkOrder *walkOrder;
 };
 
 typedef struct g_fileSnippet {
@@ -212,6 +223,26 @@ int g_walkRecursive(
     g_walkAction action,
     void* userData);
 
+/* Flags for g_walkMulti */
+#define G_WALK_NOSCOPE (1) /* Do not walk scopes, as g_walkNoScope */
+#define G_WALK_RECURSIVE (2) /* Walk scopes recursively, as g_walkRecursive */
+#define G_WALK_PHASES (4) /* Run each action on all objects before the next */
+
+/* Run multiple actions in one walk. By default all actions are run on an object
+ * before moving to the next object. With G_WALK_PHASES, objects are found once
+ * and actions are run on them one after another, as consecutive walks would.
+ * Scopes are not claimed while phase actions run, so actions must not delete
+ * walked objects. An action that returns 0 stops only itself. Returns 0 if an
+ * action stopped.
+ */
+CORTO_G_EXPORT
+int g_walkMulti(
+    g_generator g,
+    g_walkAction *actions,
+    void **userData,
+    corto_uint32 count,
+    corto_uint32 flags);
+
 /* Recursively walk all objects, include anonymous objects. */
 CORTO_G_EXPORT
 int g_walkAll(
@@ -219,6 +250,12 @@ int g_walkAll(
     g_walkAction action,
     void* userData);
 
+/* Forget order cached by g_walkAll. The order is forgotten automatically when
+ * objects are added with g_parse or the "bootstrap" attribute is set. */
+CORTO_G_EXPORT
+void g_walkAllReset(
+    g_generator generator);
+
 /* Find generator object for object */
 CORTO_G_EXPORT
 g_object* g_findObject(
@@ -268,12 +305,38 @@ char *g_id(
     char *str,
     corto_id id);
 
+/* Find canonical object for anonymous object. Anonymous objects do not have
+ * their own identity, so objects with the same type and value share the
+ * canonical object, which is the first of them that was interned. If index is
+ * not NULL, it is set to the position of the canonical object in the table. */
+CORTO_G_EXPORT
+corto_object g_anonymousIntern(
+    g_generator g,
+    corto_object o,
+    corto_uint32 *index);
+
+/* Number anonymous object for identifiers. Objects with the same type and
+ * value get the same number. Numbers are assigned in order of first request. */
+CORTO_G_EXPORT
+corto_uint32 g_anonymousId(
+    g_generator g,
+    corto_object o);
+
 /* A check on whether an object must be parsed or not. */
 CORTO_G_EXPORT
 bool g_mustParse(
     g_generator g,
     corto_object o);
 
+/* Check whether an object must be parsed for a generator object instead of
+ * the current object. Verdicts are not cached, so this function can be called
+ * from multiple threads as long as the generator is not modified. */
+CORTO_G_EXPORT
+bool g_mustParseExt(
+    g_generator g,
+    g_object *current,
+    corto_object o);
+
 
 /* === Generator file-utility class */
 
@@ -26,6 +26,32 @@
 extern "C" {
 #endif
 
+/* Build dependency graph for generator objects. The graph can be walked
+ * multiple times with corto_genDepWalkResolver, and must be freed with
+ * corto_depresolver_free. If the "depcache" attribute is "true", the graph is
+ * cached in the hidden directory. The cache is keyed by the parse list, the
+ * types of objects and the files in the "depsources" attribute (separated by
+ * commas). Values of objects are not read, so these files must cover every
+ * file that contributes to the graph, including definitions in imported
+ * packages. Objects that are created or changed by code are not detected, and
+ * a graph with such objects must not be cached. The cache is not used if a
+ * file cannot be loaded. If the "deprefs" attribute is "false", dependencies
+ * are extracted by walking values with corto_walk instead of reading the
+ * locations of references in tables. */
+CORTO_G_EXPORT
+corto_depresolver corto_genDepBuild(
+    g_generator g);
+
+/* Walk dependency graph created by corto_genDepBuild */
+CORTO_G_EXPORT
+int corto_genDepWalkResolver(
+    g_generator g,
+    corto_depresolver resolver,
+    corto_depresolver_action onDeclare,
+    corto_depresolver_action onDefine,
+    void* userData);
+
+/* Build and walk dependency graph for generator objects */
 CORTO_G_EXPORT
 int corto_genDepWalk(
     g_generator g,
@@ -20,430 +20,2606 @@
  */
 
 #include <corto.g>
+#include "hash.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define G_INDEX_MIN_SIZE (64)
+#define G_STACK_MIN_SIZE (64)
+#define G_ARENA_MIN_CHUNK (16 * 1024)
+#define G_ARENA_MAX_CHUNK (1024 * 1024)
+
+/* Edges of the frozen graph are packed in a single integer. The lower bits
+ * contain flags, the upper bits the index of the dependent item. */
+#define G_EDGE_DECLARE (1) /* Dependent can be declared (otherwise defined) */
+#define G_EDGE_WEAK (2)
+#define G_EDGE_PROCESSED (4)
+#define G_EDGE_BROKEN (8) /* Weak dependency was broken by last walk */
+#define G_EDGE_SHIFT (4)
+#define G_EDGE_MAX_ITEMS (1 << (32 - G_EDGE_SHIFT))
+#define G_EDGE_ITEM(edge) ((edge) >> G_EDGE_SHIFT)
+
+/* Maximum number of events visited when testing if a dependency is implied by
+ * other dependencies */
+#define G_REDUCE_MAX_VISITS (64)
+
+/* Stored graph. The file contains the header, the offset of the name of each
+ * item in the string table, the offsets and edges of the frozen graph, and the
+ * string table. All arrays are 4 byte aligned and in native byte order, so
+ * they are read in place from a mapped file. Loading adds the items and
+ * dependencies to the resolver, which freezes them again before walking. */
+#define G_FILE_MAGIC "CDEP"
+#define G_FILE_VERSION (1)
+
+typedef struct g_fileHeader {
+    char magic[4];
+    corto_uint32 version;
+    corto_uint64 key;
+    corto_uint32 count;
+    corto_uint32 edgeCount;
+    corto_uint32 stringsLength;
+    corto_uint32 reserved;
+} g_fileHeader;
+
+/* File contents in memory */
+typedef struct g_fileMap {
+    void *ptr;
+    size_t size;
+} g_fileMap;
+
+/* Items and dependencies are never freed individually, so they are allocated
+ * from an arena of chunks that is released in one go with the resolver. */
+typedef struct g_arenaChunk g_arenaChunk;
+struct g_arenaChunk {
+    g_arenaChunk *next;
+    size_t size;
+    size_t used;
+};
+
+typedef struct g_arena {
+    g_arenaChunk *chunks; /* Most recent chunk first */
+    size_t reserved;
+    size_t used;
+    corto_uint32 count;
+} g_arena;
+
+/* Item in a frontier of items that are printed in parallel */
+typedef struct g_frontierItem {
+    corto_uint32 item;
+    corto_bool declare;
+    corto_bool define;
+} g_frontierItem;
+
+/* Pool of worker threads that execute callbacks for a frontier. The thread
+ * that walks the resolver participates in executing the frontier. */
+typedef struct g_workerPool {
+    struct corto_depresolver_s *data;
+    ut_thread *threads;
+    corto_uint32 count;
+    struct ut_mutex_s lock;
+    struct ut_cond_s start; /* Signalled when a new frontier is available */
+    struct ut_cond_s done; /* Signalled when all items in frontier are done */
+    corto_uint32 generation; /* Incremented for each frontier */
+    corto_uint32 size; /* Number of items in frontier */
+    corto_uint32 next; /* Next item in frontier to execute */
+    corto_uint32 finished; /* Number of executed items in frontier */
+    corto_bool quit;
+} g_workerPool;
+
+/* Dependency between members of a strongly connected component */
+typedef struct g_mfasEdge {
+    corto_uint32 from; /* Member that is the dependency */
+    corto_uint32 to; /* Member that is the dependent */
+    corto_uint32 edge; /* Edge in frozen graph */
+    corto_bool breakable;
+} g_mfasEdge;
+
+/* Member of a strongly connected component */
+typedef struct g_mfasNode {
+    corto_uint32 inCount; /* Dependencies on members that are not ordered */
+    corto_uint32 outCount; /* Dependents that are not ordered */
+    corto_int64 inWeight;
+    corto_int64 outWeight;
+    corto_uint32 rank; /* Position of member in order */
+    corto_bool ordered;
+} g_mfasNode;
+
+/* Entry in heap of members, ordered by outWeight - inWeight */
+typedef struct g_mfasEntry {
+    corto_int64 delta;
+    corto_uint32 node;
+} g_mfasEntry;
+
+/* Administration for finding a minimal set of dependencies to break. Arrays
+ * are reused for every component. */
+typedef struct g_mfas {
+    g_mfasNode *nodes;
+    corto_uint32 *outOffsets; /* Edges of node i are in out[outOffsets[i]] up to out[outOffsets[i + 1]] */
+    corto_uint32 *inOffsets;
+    corto_uint32 *sources; /* Stack of members without unordered dependencies */
+    corto_uint32 *sinks; /* Stack of members without unordered dependents */
+    corto_uint32 nodesSize;
+    g_mfasEdge *edges;
+    corto_uint32 *out;
+    corto_uint32 *in;
+    corto_uint32 edgeCount;
+    corto_uint32 edgesSize;
+    g_mfasEntry *heap;
+    corto_uint32 heapCount;
+    corto_uint32 heapSize;
+} g_mfas;
+
+/* Weak dependency between members of a component, which may be broken */
+typedef struct g_sccCandidate {
+    corto_uint32 edge; /* Edge in frozen graph */
+    corto_uint32 item; /* Item that is the dependency */
+    corto_uint32 event; /* Event of dependent */
+} g_sccCandidate;
+
+/* Administration for resolving components with cycles. Events are the declare
+ * (2 * member) and define (2 * member + 1) of the members of a component.
+ * Arrays are reused for every component. */
+typedef struct g_sccOrder {
+    corto_uint32 *members; /* Members of components found by last pass */
+    corto_uint32 memberCount;
+    corto_uint32 memberSize;
+    corto_uint32 *components; /* Offset of each component in members */
+    corto_uint32 componentCount;
+    corto_uint32 componentSize;
+    corto_uint32 component; /* Id of last component */
+
+    /* Events must be ordered after the events they depend on through
+     * dependencies that are not broken. Weak dependencies are constraints
+     * that may be broken, and are marked with G_SCC_WEAK. */
+    corto_uint32 *from;
+    corto_uint32 *to;
+    corto_uint32 constraintCount;
+    corto_uint32 constraintSize;
+    corto_uint32 *offsets; /* Constraints of event i start at offsets[i] */
+    corto_uint32 *targets;
+    corto_uint32 *inCount; /* Constraints on event that are not ordered */
+    corto_uint32 *weakCount; /* Weak constraints that are not ordered */
+    corto_uint32 *position; /* Position of event in order */
+    corto_uint32 *heap; /* Events that can be ordered, by priority */
+    corto_uint32 *blocked; /* Events that only wait for weak constraints */
+    corto_uint32 *byPriority; /* Member for each priority */
+    corto_uint32 eventSize; /* Number of members arrays can hold */
+    g_sccCandidate *candidates;
+    g_sccCandidate *sorted; /* Candidates by position of dependent */
+    corto_uint32 candidateCount;
+    corto_uint32 candidateSize;
+} g_sccOrder;
+
+#define G_SCC_WEAK (0x80000000)
 
-#define CYCLE_DEPTH (1024)
+typedef struct g_dependency* g_dependency;
 
+/* Items and dependencies describe the graph while it is being built. Before
+ * walking, the graph is frozen into flat arrays (see g_freeze). */
 typedef struct g_item* g_item;
 struct g_item {
     void* o;
-    corto_bool declared;
-    corto_bool defined;
-    corto_int32 declareCount;
-    corto_int32 defineCount;
-    ut_ll onDeclared;
-    ut_ll onDefined;
+    g_item next; /* Next item in resolver item list */
+    g_item prev;
+    g_dependency onDeclared; /* Linked through g_dependency.next */
+    g_dependency onDefined;
+    g_dependency dependsOn; /* Linked through g_dependency.nextDependsOn */
+    corto_uint32 hash; /* Hash of object, so index can grow without rehashing */
+    corto_uint32 index; /* Index of item in frozen graph */
+    corto_bool dirty; /* Item changed since last walk */
+    corto_bool removed;
 };
 
-typedef struct g_dependency* g_dependency;
 struct g_dependency {
     corto_uint8 kind;
+    corto_uint8 dependencyKind;
     g_item item;
     g_item dependency;
+    g_dependency next; /* Next dependency in onDeclared or onDefined list */
+    g_dependency nextDependsOn; /* Next dependency in dependsOn list of item */
     corto_bool weak; /* A weak dependency may be degraded to DECLARED if a cycle can otherwise not be broken. */
-    corto_uint32 marked;
-    corto_bool processed; /* When a cycles are broken, it can occur that a dependency is resolved twice, as
-                          a cycle is broken by resolving a dependency. This could cause refcounts to dive below
-                          zero which is undesired. */
 };
 
+/* State of an item in the frozen graph */
+typedef struct g_itemState {
+    corto_int32 declareCount;
+    corto_int32 defineCount;
+    corto_uint32 walk; /* Equals resolver walk if item is in current walk */
+
+    /* Administration for strongly connected component detection */
+    corto_int32 sccIteration; /* Equals resolver iteration if item has been visited */
+    corto_uint32 sccIndex;
+    corto_uint32 sccLowlink;
+    corto_uint32 sccMember; /* Index of item in component with cycles */
+    corto_uint32 sccComponent; /* Component of item, if it has cycles */
+    corto_uint32 declareOrder; /* Position of declare in sequence of printed items, 0 if not printed */
+    corto_uint32 defineOrder;
+
+    corto_bool declared;
+    corto_bool defined;
+    corto_bool sccOnStack;
+} g_itemState;
+
+/* Actions recorded by the tracer */
+typedef enum g_traceAction {
+    G_TRACE_DECLARE, /* Item is declared */
+    G_TRACE_DEFINE, /* Item is defined */
+    G_TRACE_RESOLVE, /* Edge from item to other item is resolved */
+    G_TRACE_BREAK, /* Weak edge from item to other item is broken */
+    G_TRACE_CYCLE, /* Item is root of component with other items */
+    G_TRACE_NO_BREAK /* No edge found to break in component of item */
+} g_traceAction;
+
+/* Event in trace of a walk. Items are stored as index in the frozen graph, so
+ * names are only looked up when the trace is converted to a string. */
+typedef struct g_traceEvent {
+    corto_uint32 item;
+    corto_uint32 other; /* Index of other item, or number of items for cycles */
+    corto_uint8 action;
+    corto_uint8 edge; /* Flags of edge, for RESOLVE and BREAK */
+} g_traceEvent;
+
+/* Record trace event. Arguments are only evaluated if tracing is enabled. */
+#define G_TRACE(data, _action, _item, _other, _edge)\
+    do {\
+        if ((data)->trace) {\
+            g_traceEvent *ev = &(data)->trace[(data)->traceCount ++ & (data)->traceMask];\
+            ev->item = (_item);\
+            ev->other = (_other);\
+            ev->action = (_action);\
+            ev->edge = (_edge);\
+        }\
+    } while (0)
+
 struct corto_depresolver_s {
-    ut_ll items;
-    ut_ll toPrint;
+    g_arena arena;
+    g_item items; /* Linked through g_item.next, most recent item first */
+    g_item *index; /* Open addressing table that maps objects to items */
+    corto_uint32 indexSize; /* Always a power of two */
+    corto_uint32 itemCount;
+    g_dependency *depIndex; /* Open addressing table with all dependencies */
+    corto_uint32 depIndexSize; /* Always a power of two */
+    corto_uint32 depCount;
+    corto_uint32 duplicateCount; /* Number of ignored duplicate dependencies */
+    corto_uint32 *toPrint; /* Stack of items that can be printed, or heap
+                            * ordered by index if resolver is ordered */
+    corto_uint32 toPrintCount;
+    corto_uint32 toPrintSize;
     corto_depresolver_action onDeclare;
     corto_depresolver_action onDefine;
     void* userData;
-    g_dependency stack[CYCLE_DEPTH]; /* For cycle detection */
-    corto_uint32 sp;
-    corto_int32 iteration; /* dependency.marked equals this number when it has been marked in the current
+    corto_depresolver_compare compare;
+
+    /* Identity of items. Items are compared by pointer if there is no hash
+     * function. Callbacks are never invoked while walking. */
+    corto_depresolver_hashAction hash;
+    corto_depresolver_equalsAction equals;
+    corto_depresolver_nameAction name;
+    void *keyData;
+    void *root; /* Item that is always declared and defined */
+    corto_uint32 rootIndex; /* Index of root in frozen graph, or count */
+
+    /* Frozen graph. The edges of item i are stored in edges[offsets[2 * i]]
+     * up to edges[offsets[2 * i + 2]]. The first edges are resolved when the
+     * item is declared, the edges from edges[offsets[2 * i + 1]] are resolved
+     * when the item is defined. Edges are stored in the same order as in the
+     * onDeclared and onDefined lists. */
+    corto_bool frozen; /* FALSE if graph changed since it was frozen */
+    corto_uint32 count; /* Number of items in frozen graph */
+    corto_uint32 countSize;
+    void **objects;
+    g_itemState *state;
+    corto_uint32 *offsets;
+    corto_uint32 *edges;
+    corto_uint32 edgeCount;
+    corto_uint32 edgeSize;
+
+    /* Items that are printed by the current walk. A full walk contains all
+     * items, an update only the items affected by changes. */
+    corto_uint32 *walkItems;
+    corto_uint32 walkCount;
+    corto_uint32 walkSize;
+    corto_uint32 walk;
+    corto_bool walked; /* TRUE if last walk resolved all items */
+    g_item *dirty; /* Items changed since last walk */
+    corto_uint32 dirtyCount;
+    corto_uint32 dirtySize;
+
+    /* Parallel printing of frontiers */
+    corto_uint32 flags;
+    corto_uint32 workers;
+    g_frontierItem *frontier;
+    corto_uint32 frontierCount;
+    corto_uint32 frontierSize;
+    g_workerPool *pool; /* Created by the first parallel walk */
+    corto_bool parallel; /* Current walk prints frontiers on pool */
+
+    /* Explicit stacks for cycle detection, so graph depth is not bounded by
+     * the C stack. */
+    struct g_sccFrame *frames;
+    corto_uint32 framesSize;
+    corto_uint32 *sccStack;
+    corto_uint32 sccStackSize;
+    corto_uint32 sccSp;
+    corto_uint32 sccIndex;
+    corto_int32 iteration; /* item.sccIteration equals this number when it has been visited in the current
                             * cycle detection iteration. */
     corto_bool bootstrap; /* If a bootstrap is detected, disregard all dependencies. This can only mean that
                           the builtin-types are being generated, since these are the only ones that can
                           introduce a bootstrap (typeof(class) == class).
                           In this case, dependencies don't matter (and are non-resolvable)*/
+    corto_uint32 sequence; /* Number of declares and defines printed by resolver */
+
+    /* Statistics */
+    corto_uint32 declareEdges; /* Number of dependencies by kind */
+    corto_uint32 defineEdges;
+    corto_uint32 weakEdges;
+    corto_uint32 brokenCount; /* Number of dependencies broken by walk */
+    corto_uint32 reducedCount; /* Number of implied dependencies removed by freeze */
+    corto_bool sccCounting; /* Count components found by cycle detection */
+    corto_uint32 sccCount;
+    corto_uint32 sccMaxSize;
+    corto_uint32 sccItems;
+    struct timespec created;
+    double buildTime;
+    double freezeTime;
+    double cycleTime;
+    double emitTime;
+    g_mfas mfas;
+    g_sccOrder order;
+
+    /* Events of the last walk. The ring buffer keeps the most recent events,
+     * which are reported when a walk fails. */
+    g_traceEvent *trace; /* NULL if tracing is disabled */
+    corto_uint32 traceMask; /* Size of buffer minus one */
+    corto_uint64 traceCount; /* Number of events recorded by last walk */
 };
 
-static int g_itemPrint(void* o, void* userData);
+static void g_itemDirty(struct g_item *item, struct corto_depresolver_s* data);
+static int g_itemPrintFrontiers(struct corto_depresolver_s* data);
+
+/* Allocate memory from arena. Memory is aligned to 8 bytes. */
+static
+void* g_arenaAlloc(
+    g_arena *arena,
+    size_t size)
+{
+    g_arenaChunk *chunk = arena->chunks;
+
+    size = (size + 7) & ~(size_t)7;
+
+    if (!chunk || (chunk->used + size) > chunk->size) {
+        /* Grow chunks geometrically, so large graphs use few chunks */
+        size_t chunkSize = chunk ? chunk->size * 2 : G_ARENA_MIN_CHUNK;
+        if (chunkSize > G_ARENA_MAX_CHUNK) {
+            chunkSize = G_ARENA_MAX_CHUNK;
+        }
+        if (chunkSize < size) {
+            chunkSize = size;
+        }
+
+        chunk = corto_alloc(sizeof(g_arenaChunk) + chunkSize);
+        chunk->next = arena->chunks;
+        chunk->size = chunkSize;
+        chunk->used = 0;
+        arena->chunks = chunk;
+        arena->reserved += chunkSize;
+        arena->count ++;
+    }
+
+    void *result = (char*)(chunk + 1) + chunk->used;
+    chunk->used += size;
+    arena->used += size;
+
+    return result;
+}
+
+/* Release all chunks of arena */
+static
+void g_arenaFree(
+    g_arena *arena)
+{
+    g_arenaChunk *chunk, *next;
+
+    for (chunk = arena->chunks; chunk; chunk = next) {
+        next = chunk->next;
+        corto_dealloc(chunk);
+    }
+
+    arena->chunks = NULL;
+}
+
+/* Seconds elapsed since start */
+static
+double g_elapsed(
+    struct timespec *start)
+{
+    struct timespec now;
+    ut_time_get(&now);
+    return ut_time_to_double(ut_time_sub(now, *start));
+}
 
 /* Create new item */
 static
 g_item g_itemNew(
-    corto_object o,
+    void *o,
+    corto_uint32 hash,
     corto_depresolver data)
 {
     g_item result;
 
-    result = corto_alloc(sizeof(struct g_item));
+    result = g_arenaAlloc(&data->arena, sizeof(struct g_item));
     result->o = o;
-    result->declared = FALSE;
-    result->defined = FALSE;
-    result->declareCount = 0;
-    result->defineCount = 0;
+    result->hash = hash;
     result->onDeclared = NULL;
     result->onDefined = NULL;
-
-    if (o == root_o) {
-        result->declared = TRUE;
-        result->defined = TRUE;
+    result->dependsOn = NULL;
+    result->index = 0;
+    result->dirty = FALSE;
+    result->removed = FALSE;
+
+    result->next = data->items;
+    result->prev = NULL;
+    if (data->items) {
+        data->items->prev = result;
     }
+    data->items = result;
 
-    ut_ll_insert(data->items, result);
+    data->frozen = FALSE;
+    g_itemDirty(result, data);
 
     return result;
 }
 
-/* Delete item */
+/* Mark item as changed, so it is printed by the next update */
 static
-void g_itemFree(
-    g_item item)
+void g_itemDirty(
+    g_item item,
+    corto_depresolver data)
 {
-    g_dependency dep;
+    /* Before the first walk everything is printed anyway */
+    if (!data->walked || item->dirty) {
+        return;
+    }
 
-    /* Free onDeclared list */
-    if (item->onDeclared) {
-        while((dep = ut_ll_takeFirst(item->onDeclared))) {
-            corto_dealloc(dep);
-        }
-        ut_ll_free(item->onDeclared);
+    if (data->dirtyCount == data->dirtySize) {
+        data->dirtySize = data->dirtySize
+            ? data->dirtySize * 2
+            : G_STACK_MIN_SIZE;
+        data->dirty = corto_realloc(data->dirty, data->dirtySize * sizeof(g_item));
     }
 
-    /* Free onDefined list */
-    if (item->onDefined) {
-        while((dep = ut_ll_takeFirst(item->onDefined))) {
-            corto_dealloc(dep);
-        }
-        ut_ll_free(item->onDefined);
+    item->dirty = TRUE;
+    data->dirty[data->dirtyCount ++] = item;
+}
+
+/* Remove dependency from the onDeclared or onDefined list it is stored in */
+static
+void g_dependencyUnlink(
+    g_dependency dep)
+{
+    g_dependency *ptr = dep->dependencyKind == CORTO_DECLARED
+        ? &dep->dependency->onDeclared
+        : &dep->dependency->onDefined;
+
+    while (*ptr != dep) {
+        ptr = &(*ptr)->next;
+    }
+    *ptr = dep->next;
+}
+
+/* Remove dependency from the dependsOn list of its dependent item */
+static
+void g_dependencyUnlinkDependent(
+    g_dependency dep)
+{
+    g_dependency *ptr = &dep->item->dependsOn;
+
+    while (*ptr != dep) {
+        ptr = &(*ptr)->nextDependsOn;
     }
+    *ptr = dep->nextDependsOn;
+}
 
-    corto_dealloc(item);
+/* Hash object with hash function of resolver */
+static
+corto_uint32 g_itemHash(
+    corto_depresolver data,
+    void *o)
+{
+    if (data->hash) {
+        return data->hash(o, data->keyData);
+    } else {
+        return g_ptrHash(o);
+    }
 }
 
-/* Lookup item in administration */
+/* Find slot for object in index. Returns empty slot if object is not found. */
 static
-g_item g_itemLookup(
-    corto_object o,
-    corto_depresolver data)
+corto_uint32 g_indexSlot(
+    corto_depresolver data,
+    void *o,
+    corto_uint32 hash)
 {
-    ut_iter iter;
+    corto_uint32 mask = data->indexSize - 1;
+    corto_uint32 slot = hash & mask;
     g_item item;
 
-    /* Lookup item for 'o' in items list */
-    item = NULL;
-    iter = ut_ll_iter(data->items);
-    while(!item && ut_iter_hasNext(&iter)) {
-        item = ut_iter_next(&iter);
-        if (item->o != o) {
-            item = NULL;
+    if (data->equals) {
+        while ((item = data->index[slot]) && (item->hash != hash ||
+            !data->equals(item->o, o, data->keyData)))
+        {
+            slot = (slot + 1) & mask;
+        }
+    } else {
+        while ((item = data->index[slot]) && item->o != o) {
+            slot = (slot + 1) & mask;
         }
     }
 
-    /* If item did not yet exist, insert it in data */
-    if (!item) {
-        item = g_itemNew(o, data);
-    }
-
-    return item;
+    return slot;
 }
 
-/* Resolve dependency, decrease refcount */
+/* Allocate index that can hold at least 'capacity' items without growing */
 static
-int g_itemResolveDependency(
-    void* o,
-    void* userData)
+void g_indexInit(
+    corto_depresolver data,
+    corto_uint32 capacity)
 {
-    g_dependency dep;
-    corto_depresolver data;
+    corto_uint32 size = G_INDEX_MIN_SIZE;
 
-    dep = o;
-    data = userData;
+    /* Keep load factor below 0.7 */
+    while (size * 7 < capacity * 10) {
+        size *= 2;
+    }
 
-    if (!dep->processed) {
-        ut_debug("depresolver: resolve dependency: %s '%s' before ? '%s'",
-                corto_ptr_str(&dep->kind, corto_state_o, 0),
-                corto_fullpath(NULL, dep->item->o),
-                corto_fullpath(NULL, dep->dependency->o));
+    data->index = corto_calloc(size * sizeof(g_item));
+    data->indexSize = size;
+}
 
-        switch(dep->kind) {
-        case CORTO_DECLARED:
-            dep->item->declareCount--;
+/* Hash of item in index, for rehashing */
+static
+corto_uint32 g_indexHash(
+    const void *entry,
+    void *ctx)
+{
+    CORTO_UNUSED(ctx);
+    return (*(g_item*)entry)->hash;
+}
 
-            ut_assert(dep->item->declareCount >= 0, "negative declareCount for item '%s'.", corto_idof(dep->item->o));
+/* Remove item from index. Items after the removed item that are part of
+ * the same probe sequence are shifted back, so lookups never hit a hole. */
+static
+void g_indexRemove(
+    corto_depresolver data,
+    corto_uint32 slot)
+{
+    corto_uint32 mask = data->indexSize - 1;
+    corto_uint32 i = slot, j = slot;
 
-            if (!dep->item->declareCount) {
-                ut_ll_insert(data->toPrint, dep->item);
-            }
-            break;
-        case CORTO_VALID:
-            dep->item->defineCount--;
+    data->index[i] = NULL;
 
-            ut_assert(dep->item->defineCount >= 0, "negative defineCount for item '%s'.", corto_idof(dep->item->o));
+    while (data->index[j = (j + 1) & mask]) {
+        corto_uint32 k = data->index[j]->hash & mask;
 
-            if (!dep->item->defineCount) {
-                ut_ll_insert(data->toPrint, dep->item);
-            }
-            break;
+        /* Leave item if its home slot is cyclically in (i, j] */
+        if (i <= j ? (i < k && k <= j) : (i < k || k <= j)) {
+            continue;
         }
-    }
 
-    dep->processed = TRUE;
+        data->index[i] = data->index[j];
+        data->index[j] = NULL;
+        i = j;
+    }
+}
 
-    return 1;
+/* Hash dependency. Two dependencies are the same if they have the same items
+ * and kinds. */
+static
+corto_uint32 g_dependencyHash(
+    g_item item,
+    corto_uint8 kind,
+    g_item dependency,
+    corto_uint8 dependencyKind)
+{
+    return g_ptrPairHash(item, dependency) + (kind << 4) + dependencyKind;
 }
 
-/* Declare item */
+/* Find slot for dependency in dependency index. Returns empty slot if the
+ * dependency is not found. */
 static
-void g_itemDeclare(
+corto_uint32 g_depIndexSlot(
+    g_dependency *index,
+    corto_uint32 size,
     g_item item,
-    corto_depresolver data)
+    corto_uint8 kind,
+    g_item dependency,
+    corto_uint8 dependencyKind)
 {
-    if (data->onDeclare) {
-        data->onDeclare(item->o, data->userData);
+    corto_uint32 mask = size - 1;
+    corto_uint32 slot =
+        g_dependencyHash(item, kind, dependency, dependencyKind) & mask;
+    g_dependency dep;
+
+    while ((dep = index[slot]) && (dep->item != item ||
+        dep->dependency != dependency || dep->kind != kind ||
+        dep->dependencyKind != dependencyKind))
+    {
+        slot = (slot + 1) & mask;
     }
+
+    return slot;
 }
 
-/* Define item */
+/* Hash of dependency in dependency index, for rehashing */
 static
-void g_itemDefine(
-    g_item item,
-    corto_depresolver data)
+corto_uint32 g_depIndexHash(
+    const void *entry,
+    void *ctx)
 {
-    if (data->onDefine) {
-        data->onDefine(item->o, data->userData);
+    g_dependency dep = *(g_dependency*)entry;
+    CORTO_UNUSED(ctx);
+    return g_dependencyHash(
+        dep->item, dep->kind, dep->dependency, dep->dependencyKind);
+}
+
+/* Update number of dependencies by kind */
+static
+void g_dependencyCountKind(
+    corto_depresolver data,
+    g_dependency dep,
+    corto_int32 delta)
+{
+    if (dep->kind == CORTO_DECLARED) {
+        data->declareEdges += delta;
+    } else {
+        data->defineEdges += delta;
+    }
+    if (dep->weak) {
+        data->weakEdges += delta;
     }
 }
 
-/* Declare an item */
+/* Remove dependency from dependency index, like g_indexRemove */
 static
-int g_itemPrint(
-    void* o,
-    void* userData)
+void g_depIndexRemove(
+    corto_depresolver data,
+    g_dependency dep)
 {
-    g_item item;
-    corto_depresolver data;
+    corto_uint32 mask = data->depIndexSize - 1;
+    corto_uint32 i, j;
+    g_dependency next;
 
-    item = o;
-    data = userData;
+    i = j = g_depIndexSlot(data->depIndex, data->depIndexSize, dep->item,
+        dep->kind, dep->dependency, dep->dependencyKind);
+    data->depIndex[i] = NULL;
 
-    /* Walk DECLARED dependencies */
-    if (!item->declared && !item->declareCount) {
-        item->declared = TRUE;
-        ut_debug("depresolver: declare '%s'", corto_fullpath(NULL, item->o));
-        g_itemDeclare(item, data);
-        if (item->onDeclared) {
-            ut_ll_walk(item->onDeclared, g_itemResolveDependency, data);
+    while ((next = data->depIndex[j = (j + 1) & mask])) {
+        corto_uint32 k = g_dependencyHash(next->item, next->kind,
+            next->dependency, next->dependencyKind) & mask;
+
+        if (i <= j ? (i < k && k <= j) : (i < k || k <= j)) {
+            continue;
         }
+
+        data->depIndex[i] = next;
+        data->depIndex[j] = NULL;
+        i = j;
     }
 
-    /* Walk DECLARED | DEFINED dependencies */
-    if (item->declared && !item->defined && !item->defineCount) {
-        item->defined = TRUE;
-        ut_debug("depresolver: define '%s'", corto_fullpath(NULL, item->o));
-        g_itemDefine(item, data);
-        if (item->onDefined) {
-            ut_ll_walk(item->onDefined, g_itemResolveDependency, data);
+    data->depCount --;
+    g_dependencyCountKind(data, dep, -1);
+}
+
+/* Find item in administration, returns NULL if not found */
+static
+g_item g_itemFind(
+    void *o,
+    corto_depresolver data)
+{
+    return data->index[g_indexSlot(data, o, g_itemHash(data, o))];
+}
+
+/* Lookup item in administration */
+static
+g_item g_itemLookup(
+    void *o,
+    corto_depresolver data)
+{
+    corto_uint32 hash = g_itemHash(data, o);
+    corto_uint32 slot = g_indexSlot(data, o, hash);
+    g_item item = data->index[slot];
+
+    /* If item did not yet exist, insert it in data */
+    if (!item) {
+        if (g_tableGrow(&data->index, data->itemCount, &data->indexSize,
+            sizeof(g_item), G_INDEX_MIN_SIZE, g_indexHash, NULL))
+        {
+            slot = g_indexSlot(data, o, hash);
         }
+        item = g_itemNew(o, hash, data);
+        data->index[slot] = item;
+        data->itemCount ++;
     }
 
-    return 1;
+    return item;
 }
 
-/* Collect initial objects */
+/* Append edge for dependency to frozen graph */
 static
-int g_itemCollectinitial(
-    void* o,
-    void* userData)
+void g_freezeDependency(
+    g_dependency dep,
+    corto_depresolver data)
 {
-    g_item item;
-    corto_depresolver data;
+    if (data->edgeCount == data->edgeSize) {
+        data->edgeSize = data->edgeSize
+            ? data->edgeSize * 2
+            : G_STACK_MIN_SIZE;
+        data->edges = corto_realloc(
+            data->edges, data->edgeSize * sizeof(corto_uint32));
+    }
 
-    item = o;
-    data = userData;
+    data->edges[data->edgeCount ++] =
+        (dep->item->index << G_EDGE_SHIFT) |
+        (dep->kind == CORTO_DECLARED ? G_EDGE_DECLARE : 0) |
+        (dep->weak ? G_EDGE_WEAK : 0);
+}
 
-    if (!item->declareCount) {
-        ut_ll_insert(data->toPrint, item);
+/* Compare items for CORTO_DEPRESOLVER_ORDERED */
+static
+int g_itemCompare(
+    g_item *items,
+    char **paths,
+    corto_uint32 i1,
+    corto_uint32 i2,
+    corto_depresolver data)
+{
+    if (data->compare) {
+        return data->compare(items[i1]->o, items[i2]->o, data->keyData);
+    } else {
+        return strcmp(paths[i1], paths[i2]);
     }
+}
 
-    return 1;
+/* Compare edges by dependent, then by flags */
+static
+int g_edgeCompare(
+    const void *e1,
+    const void *e2)
+{
+    corto_uint32 v1 = *(corto_uint32*)e1, v2 = *(corto_uint32*)e2;
+    return v1 < v2 ? -1 : v1 > v2;
 }
 
-/* Print items (forward them to declare & define callbacks) */
+/* Sort item list for CORTO_DEPRESOLVER_ORDERED. The sort is stable, so items
+ * that compare equal keep their order in the list. */
 static
-int g_itemPrintItems(struct corto_depresolver_s* data) {
-    g_item item;
+void g_freezeOrder(
+    corto_depresolver data)
+{
+    g_item *items, item;
+    char **paths = NULL;
+    corto_uint32 *order, *tmp, count = data->itemCount, width, i;
 
-    /* Collect initial items */
-    if (!ut_ll_walk(data->items, g_itemCollectinitial, data)) {
-        goto error;
+    /* Without names all items compare equal */
+    if (!data->compare && !data->name) {
+        return;
     }
 
-    /* Print items */
-    while((item = ut_ll_takeFirst(data->toPrint))) {
-        if (!g_itemPrint(item, data)) {
-            goto error;
+    items = corto_alloc(count * sizeof(g_item));
+    order = corto_alloc(count * sizeof(corto_uint32));
+    tmp = corto_alloc(count * sizeof(corto_uint32));
+    for (i = 0, item = data->items; item; item = item->next, i ++) {
+        items[i] = item;
+        order[i] = i;
+    }
+
+    /* Look up names once, instead of for every comparison. Items without a
+     * name are only ordered by their position. */
+    if (!data->compare) {
+        paths = corto_alloc(count * sizeof(char*));
+        for (i = 0; i < count; i ++) {
+            char *name = data->name
+                ? data->name(items[i]->o, data->keyData)
+                : NULL;
+            paths[i] = name ? name : ut_strdup("");
         }
     }
 
-    return 0;
-error:
-    return -1;
-}
+    /* Bottom-up merge sort */
+    for (width = 1; width < count; width *= 2) {
+        corto_uint32 start, *swap;
+        for (start = 0; start < count; start += 2 * width) {
+            corto_uint32 mid = start + width, end = start + 2 * width, l, r, k;
+            if (mid > count) {
+                mid = count;
+            }
+            if (end > count) {
+                end = count;
+            }
+            for (l = start, r = mid, k = start; k < end; k ++) {
+                if (l < mid && (r == end ||
+                    g_itemCompare(items, paths, order[l], order[r], data) <= 0))
+                {
+                    tmp[k] = order[l ++];
+                } else {
+                    tmp[k] = order[r ++];
+                }
+            }
+        }
+        swap = order;
+        order = tmp;
+        tmp = swap;
+    }
 
-static
-int g_itemResolveCycles(
-    g_item item,
-    struct corto_depresolver_s* data);
+    /* Relink item list in sorted order */
+    data->items = NULL;
+    for (i = count; i > 0; i --) {
+        item = items[order[i - 1]];
+        item->prev = NULL;
+        item->next = data->items;
+        if (data->items) {
+            data->items->prev = item;
+        }
+        data->items = item;
+    }
+
+    if (paths) {
+        for (i = 0; i < count; i ++) {
+            corto_dealloc(paths[i]);
+        }
+        corto_dealloc(paths);
+    }
+    corto_dealloc(items);
+    corto_dealloc(order);
+    corto_dealloc(tmp);
+}
 
-/* Scan stack for occurrence of dependency. */
+/* Test if event can be reached from another event through dependencies that
+ * cannot be broken, without using edge 'skip'. Events are the declare
+ * (2 * item) and define (2 * item + 1) of items. An item is always defined
+ * after it is declared, so every declare event leads to its define event.
+ * Paths do not go through the root item, as the walk resolves its
+ * dependencies before anything is printed, so they do not order other items.
+ * The search gives up after G_REDUCE_MAX_VISITS events. */
 static
-corto_uint32 g_dependencyOnStack(
-    g_dependency dep,
-    struct corto_depresolver_s* data)
+corto_bool g_reducePath(
+    corto_uint32 from,
+    corto_uint32 to,
+    corto_uint32 skip,
+    corto_uint32 *visited,
+    corto_uint32 stamp,
+    corto_uint32 *stack,
+    corto_depresolver data)
 {
-    corto_uint32 i;
-    corto_bool found;
+    corto_uint32 sp = 0, visits = 0;
 
-    i = 0;
-    found = FALSE;
-    for(i=0; i<data->sp; i++) {
-        if (data->stack[i] == dep) {
-            found = TRUE;
-            break;
+    visited[from] = stamp;
+    stack[sp ++] = from;
+
+    while (sp && visits < G_REDUCE_MAX_VISITS) {
+        corto_uint32 event = stack[-- sp], e, end;
+        visits ++;
+
+        /* Declare of item leads to define of item */
+        if (!(event & 1)) {
+            if (event + 1 == to) {
+                return TRUE;
+            }
+            if (visited[event + 1] != stamp) {
+                visited[event + 1] = stamp;
+                stack[sp ++] = event + 1;
+            }
+        }
+
+        end = data->offsets[event + 1];
+        for (e = data->offsets[event]; e < end; e ++) {
+            corto_uint32 edge = data->edges[e], next;
+            if (e == skip || (edge & (G_EDGE_WEAK | G_EDGE_PROCESSED)) ||
+                G_EDGE_ITEM(edge) == data->rootIndex)
+            {
+                continue;
+            }
+            next = 2 * G_EDGE_ITEM(edge) + !(edge & G_EDGE_DECLARE);
+            if (next == to) {
+                return TRUE;
+            }
+            if (visited[next] != stamp) {
+                visited[next] = stamp;
+                stack[sp ++] = next;
+            }
         }
     }
 
-    return found ? i + 1 : 0; /* zero indicates that the dependency is not found. */
+    return FALSE;
 }
 
-/* Resolve cycles for dependency */
+/* Remove dependencies that are implied by other dependencies. A dependency is
+ * implied if the dependent is reached from the dependency through dependencies
+ * that cannot be broken. Removing an edge does not change which events can
+ * be reached from each other, so edges can be removed one at a time, and the
+ * remaining edges still imply the removed edges. Removed edges are marked as
+ * processed, and dropped from the frozen graph afterwards. */
 static
-void g_itemResolveDependencyCycles(
-    g_dependency dep,
-    struct corto_depresolver_s* data)
+void g_freezeReduce(
+    corto_depresolver data)
 {
-    corto_uint32 sp;
+    corto_uint32 events = 2 * data->count, i, e, w = 0, start = 0, stamp = 0;
+    corto_uint32 *visited = corto_calloc((events ? events : 1) * sizeof(corto_uint32));
+    corto_uint32 *stack = corto_alloc((events ? events : 1) * sizeof(corto_uint32));
 
-    /* If item is already marked, there is no need to investigate it further. */
-    if (dep->marked != data->iteration) {
-        /* If dependency is not on stack, scan further, if on stack, a cycle is found. */
-        if (!(sp = g_dependencyOnStack(dep, data))) {
-            data->stack[data->sp] = dep;
-            data->sp++;
-            ut_assert(data->sp < CYCLE_DEPTH, "stack-bound overflow.");
+    data->reducedCount = 0;
 
-            /* Forward item and mark it. */
-            g_itemResolveCycles(dep->item, data);
-            dep->marked = data->iteration;
-            data->sp--;
+    for (i = 0; i < events; i ++) {
+        corto_uint32 end = data->offsets[i + 1];
 
-        /* If a cycle is found, look on the stack for a weak dependency. */
-        } else {
-            corto_uint32 i;
+        /* Dependencies of the root item are resolved by the walk */
+        if (i / 2 == data->rootIndex) {
+            continue;
+        }
 
-            ut_debug("depresolver: >> begin breaking cycle [%p]", dep);
-            for(i = sp - 1; i < data->sp; i++) {
-                ut_debug("depresolver: on stack: can't %s '%s' before DECLARED|DEFINED '%s'",
-                    corto_ptr_str(&data->stack[i]->kind, corto_state_o, 0),
-                    corto_fullpath(NULL, data->stack[i]->item->o),
-                    corto_fullpath(NULL, data->stack[i]->dependency->o));
+        for (e = data->offsets[i]; e < end; e ++) {
+            corto_uint32 edge = data->edges[e];
+            corto_uint32 to = 2 * G_EDGE_ITEM(edge) + !(edge & G_EDGE_DECLARE);
+            if (G_EDGE_ITEM(edge) == data->rootIndex) {
+                continue;
             }
+            if (g_reducePath(i, to, e, visited, ++ stamp, stack, data)) {
+                data->edges[e] = edge | G_EDGE_PROCESSED;
+                data->reducedCount ++;
+            }
+        }
+    }
 
-            for(i = sp - 1; i < data->sp; i++) {
-                /* Break first weak dependency */
-                if (data->stack[i]->weak && data->stack[i]->dependency->declared) {
-                    g_itemResolveDependency(data->stack[i], data);
-
-                    ut_debug("depresolver: break can't %s '%s' before DECLARED|DEFINED '%s'",
-                        corto_ptr_str(&data->stack[i]->kind, corto_state_o, 0),
-                        corto_fullpath(NULL, data->stack[i]->item->o),
-                        corto_fullpath(NULL, data->stack[i]->dependency->o));
-
-                    /* This dependency is already weakened, it cannot be weakened again. */
-                    data->stack[i]->weak = FALSE;
-                    break;
+    /* Drop removed edges */
+    if (data->reducedCount) {
+        for (i = 0; i < events; i ++) {
+            corto_uint32 end = data->offsets[i + 1];
+            data->offsets[i] = w;
+            for (e = start; e < end; e ++) {
+                if (!(data->edges[e] & G_EDGE_PROCESSED)) {
+                    data->edges[w ++] = data->edges[e];
                 }
             }
-            ut_debug("depresolver: << end breaking cycle [%p]", dep);
+            start = end;
         }
+        data->offsets[events] = w;
+        data->edgeCount = w;
     }
+
+    corto_dealloc(visited);
+    corto_dealloc(stack);
 }
 
-/* Resolve cycles.
- *
- * If there are cycles, the only cycles that can be broken are the DECLARED | DEFINED dependencies, which
- * are stored as dependency objects with the 'weak' flag set to TRUE.
- */
+/* Convert items and dependencies to the frozen graph. Walking the frozen
+ * graph only touches a few contiguous arrays, instead of chasing pointers to
+ * items and dependencies that are spread out over the arena. Items get the
+ * same order as the item list, and edges the same order as the dependency
+ * lists, so the frozen graph is walked in the same order. If the resolver is
+ * ordered, the item list is sorted first and edges are sorted by dependent, so
+ * that the frozen graph does not depend on the order of insertion. */
 static
-int g_itemResolveCycles(
-    g_item item,
-    struct corto_depresolver_s* data)
+void g_freeze(
+    corto_depresolver data)
 {
-    ut_iter iter;
+    g_item item;
     g_dependency dep;
-    corto_uint32 sp;
-
-    sp = data->sp;
-
+    corto_uint32 i;
+    corto_bool ordered = data->flags & CORTO_DEPRESOLVER_ORDERED;
+
+    ut_assert(data->itemCount < G_EDGE_MAX_ITEMS, "too many items in resolver");
+
+    /* Offsets are also needed for an empty graph */
+    if (data->itemCount > data->countSize || !data->offsets) {
+        data->countSize = data->itemCount;
+        data->objects = corto_realloc(
+            data->objects, data->countSize * sizeof(void*));
+        data->state = corto_realloc(
+            data->state, data->countSize * sizeof(g_itemState));
+        data->offsets = corto_realloc(
+            data->offsets, (2 * data->countSize + 1) * sizeof(corto_uint32));
+    }
 
-    /* If item has not yet been declared, search onDeclared list. If the item is already declared, the
-     * dependencies in this list have already been resolved, thus need not to be evaluated again. */
+    if (ordered) {
+        g_freezeOrder(data);
+    }
 
-    if (!item->declared && item->onDeclared) {
-        /* Walk dependencies */
-        iter = ut_ll_iter(item->onDeclared);
-        while((ut_iter_hasNext(&iter))) {
-            dep = ut_iter_next(&iter);
-            g_itemResolveDependencyCycles(dep, data);
+    /* Items that are not walked keep the state of the previous walk, which
+     * only succeeds if all items are defined. */
+    for (i = 0, item = data->items; item; item = item->next, i ++) {
+        item->index = i;
+        data->objects[i] = item->o;
+    }
+    data->count = i;
+    data->rootIndex = data->count;
+    if (data->root) {
+        item = g_itemFind(data->root, data);
+        if (item) {
+            data->rootIndex = item->index;
         }
     }
+    memset(data->state, 0, data->count * sizeof(g_itemState));
+    for (i = 0; i < data->count; i ++) {
+        data->state[i].declared = TRUE;
+        data->state[i].defined = TRUE;
+    }
 
-    /* Walk onDefined list if item is not yet defined. */
-    if (!item->defined && item->onDefined) {
-        /* Walk dependencies */
-        iter = ut_ll_iter(item->onDefined);
-        while((ut_iter_hasNext(&iter))) {
-            dep = ut_iter_next(&iter);
-
-            ut_debug("depresolver: onDefine: can't %s '%s' before DECLARED|DEFINED '%s' (marked = %d, iteration = %d)",
-                corto_ptr_str(&dep->kind, corto_state_o, 0),
-                corto_fullpath(NULL, dep->item->o),
-                corto_fullpath(NULL, dep->dependency->o),
-                dep->marked,
-                data->iteration);
-
-            g_itemResolveDependencyCycles(dep, data);
+    data->edgeCount = 0;
+    for (item = data->items; item; item = item->next) {
+        corto_uint32 *offsets = &data->offsets[2 * item->index];
+        offsets[0] = data->edgeCount;
+        for (dep = item->onDeclared; dep; dep = dep->next) {
+            g_freezeDependency(dep, data);
         }
-     }
+        offsets[1] = data->edgeCount;
+        for (dep = item->onDefined; dep; dep = dep->next) {
+            g_freezeDependency(dep, data);
+        }
+        if (ordered && data->edgeCount > offsets[0]) {
+            qsort(&data->edges[offsets[0]], offsets[1] - offsets[0],
+                sizeof(corto_uint32), g_edgeCompare);
+            qsort(&data->edges[offsets[1]], data->edgeCount - offsets[1],
+                sizeof(corto_uint32), g_edgeCompare);
+        }
+    }
+    data->offsets[2 * data->count] = data->edgeCount;
+
+    if (data->flags & CORTO_DEPRESOLVER_REDUCE) {
+        g_freezeReduce(data);
+    }
 
-    data->sp = sp;
+    data->frozen = TRUE;
 
-    return 0;
 }
 
-/* Walk objects in correct dependency order. */
-corto_depresolver corto_depresolverCreate(
-    corto_depresolver_action onDeclare,
-    corto_depresolver_action onDefine,
-    void* userData)
+/* Add item to the items of the current walk */
+static
+void g_walkAdd(
+    corto_uint32 item,
+    corto_depresolver data)
 {
-    corto_depresolver result;
+    if (data->walkCount == data->walkSize) {
+        data->walkSize = data->walkSize
+            ? data->walkSize * 2
+            : G_STACK_MIN_SIZE;
+        data->walkItems = corto_realloc(
+            data->walkItems, data->walkSize * sizeof(corto_uint32));
+    }
 
-    result = corto_alloc(sizeof(struct corto_depresolver_s));
+    data->state[item].walk = data->walk;
+    data->walkItems[data->walkCount ++] = item;
+}
 
-    result->items = ut_ll_new();
-    result->toPrint = ut_ll_new();
-    result->onDeclare = onDeclare;
-    result->onDefine = onDefine;
-    result->userData = userData;
-    result->iteration = 0;
+/* Reset items of the walk to the state before walking. Only edges between
+ * items of the walk are counted. Other dependencies were resolved by a
+ * previous walk. */
+static
+void g_walkReset(
+    corto_depresolver data)
+{
+    corto_uint32 i, e;
+
+    for (i = 0; i < data->walkCount; i ++) {
+        corto_uint32 item = data->walkItems[i];
+        g_itemState *state = &data->state[item];
+        state->declared = state->defined = item == data->rootIndex;
+        state->declareCount = 0;
+        state->defineCount = 0;
+        state->declareOrder = 0;
+        state->defineOrder = 0;
+    }
 
-    return result;
+    for (i = 0; i < data->walkCount; i ++) {
+        corto_uint32 item = data->walkItems[i];
+        corto_uint32 end = data->offsets[2 * item + 2];
+
+        for (e = data->offsets[2 * item]; e < end; e ++) {
+            corto_uint32 edge = data->edges[e] &= ~(G_EDGE_PROCESSED | G_EDGE_BROKEN);
+            if (item == data->rootIndex) {
+                /* Root is never printed, so its edges are resolved already */
+                data->edges[e] |= G_EDGE_PROCESSED;
+            } else if (edge & G_EDGE_DECLARE) {
+                data->state[G_EDGE_ITEM(edge)].declareCount ++;
+            } else {
+                data->state[G_EDGE_ITEM(edge)].defineCount ++;
+            }
+        }
+    }
 }
 
-/* Insert dependency relation.
- *   @param o The dependee object.
+/* Push item on stack of items to print. If the resolver is ordered, items
+ * are kept in a heap, so that of the items that can be printed the item with
+ * the lowest index is printed first, regardless of the order in which items
+ * became printable. */
+static
+void g_itemPush(
+    corto_uint32 item,
+    corto_depresolver data)
+{
+    corto_uint32 i;
+
+    if (data->toPrintCount == data->toPrintSize) {
+        data->toPrintSize *= 2;
+        data->toPrint = corto_realloc(
+            data->toPrint, data->toPrintSize * sizeof(corto_uint32));
+    }
+
+    i = data->toPrintCount ++;
+    if (data->flags & CORTO_DEPRESOLVER_ORDERED) {
+        while (i) {
+            corto_uint32 parent = (i - 1) / 2;
+            if (data->toPrint[parent] <= item) {
+                break;
+            }
+            data->toPrint[i] = data->toPrint[parent];
+            i = parent;
+        }
+    }
+    data->toPrint[i] = item;
+}
+
+/* Pop next item to print */
+static
+corto_uint32 g_itemPop(
+    corto_depresolver data)
+{
+    corto_uint32 *heap = data->toPrint;
+    corto_uint32 result, last, count, i = 0;
+
+    if (!(data->flags & CORTO_DEPRESOLVER_ORDERED)) {
+        return heap[-- data->toPrintCount];
+    }
+
+    result = heap[0];
+    count = -- data->toPrintCount;
+    last = heap[count];
+    while (2 * i + 1 < count) {
+        corto_uint32 child = 2 * i + 1;
+        if (child + 1 < count && heap[child + 1] < heap[child]) {
+            child ++;
+        }
+        if (last <= heap[child]) {
+            break;
+        }
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = last;
+
+    return result;
+}
+
+/* Resolve dependency, decrease refcount */
+static
+void g_itemResolveDependency(
+    corto_uint32 item,
+    corto_uint32 e,
+    corto_depresolver data)
+{
+    corto_uint32 edge = data->edges[e];
+
+    if (!(edge & G_EDGE_PROCESSED)) {
+        corto_uint32 dependent = G_EDGE_ITEM(edge);
+        g_itemState *state = &data->state[dependent];
+
+        G_TRACE(data, G_TRACE_RESOLVE, item, dependent, edge);
+
+        if (edge & G_EDGE_DECLARE) {
+            state->declareCount--;
+
+            ut_assert(state->declareCount >= 0, "negative declareCount for item %u.", dependent);
+
+            if (!state->declareCount) {
+                g_itemPush(dependent, data);
+            }
+        } else {
+            state->defineCount--;
+
+            ut_assert(state->defineCount >= 0, "negative defineCount for item %u.", dependent);
+
+            if (!state->defineCount) {
+                g_itemPush(dependent, data);
+            }
+        }
+    }
+
+    data->edges[e] = edge | G_EDGE_PROCESSED;
+}
+
+/* Resolve all dependencies in range of edges */
+static
+void g_itemResolveDependencies(
+    corto_uint32 item,
+    corto_uint32 start,
+    corto_uint32 end,
+    corto_depresolver data)
+{
+    corto_uint32 e;
+
+    for (e = start; e < end; e ++) {
+        g_itemResolveDependency(item, e, data);
+    }
+}
+
+/* Declare item */
+static
+void g_itemDeclare(
+    corto_uint32 item,
+    corto_depresolver data)
+{
+    if (data->onDeclare) {
+        data->onDeclare(data->objects[item], data->userData);
+    }
+}
+
+/* Define item */
+static
+void g_itemDefine(
+    corto_uint32 item,
+    corto_depresolver data)
+{
+    if (data->onDefine) {
+        data->onDefine(data->objects[item], data->userData);
+    }
+}
+
+/* Declare an item */
+static
+int g_itemPrint(
+    corto_uint32 item,
+    corto_depresolver data)
+{
+    g_itemState *state = &data->state[item];
+    corto_uint32 *offsets = &data->offsets[2 * item];
+
+    /* Walk DECLARED dependencies */
+    if (!state->declared && !state->declareCount) {
+        state->declared = TRUE;
+        state->declareOrder = ++ data->sequence;
+        G_TRACE(data, G_TRACE_DECLARE, item, 0, 0);
+        g_itemDeclare(item, data);
+        g_itemResolveDependencies(item, offsets[0], offsets[1], data);
+    }
+
+    /* Walk DECLARED | DEFINED dependencies */
+    if (state->declared && !state->defined && !state->defineCount) {
+        state->defined = TRUE;
+        state->defineOrder = ++ data->sequence;
+        G_TRACE(data, G_TRACE_DEFINE, item, 0, 0);
+        g_itemDefine(item, data);
+        g_itemResolveDependencies(item, offsets[1], offsets[2], data);
+    }
+
+    return 1;
+}
+
+/* Collect initial objects */
+static
+void g_itemCollectInitial(
+    corto_depresolver data)
+{
+    corto_uint32 i;
+
+    for (i = 0; i < data->walkCount; i ++) {
+        corto_uint32 item = data->walkItems[i];
+        if (!data->state[item].declareCount) {
+            g_itemPush(item, data);
+        }
+    }
+}
+
+/* Print items (forward them to declare & define callbacks) */
+static
+int g_itemPrintItems(struct corto_depresolver_s* data) {
+    corto_uint32 item;
+
+    if (data->parallel) {
+        return g_itemPrintFrontiers(data);
+    }
+
+    /* Print items */
+    while (data->toPrintCount) {
+        item = g_itemPop(data);
+        if (!g_itemPrint(item, data)) {
+            goto error;
+        }
+    }
+
+    return 0;
+error:
+    return -1;
+}
+
+/* Execute callbacks for item in frontier */
+static
+void g_frontierItemPrint(
+    g_frontierItem *fi,
+    corto_depresolver data)
+{
+    if (fi->declare) {
+        g_itemDeclare(fi->item, data);
+    }
+    if (fi->define) {
+        g_itemDefine(fi->item, data);
+    }
+}
+
+/* Execute items of the current frontier until no items are left. Must be
+ * called with the pool lock held. */
+static
+void g_workerPoolRun(
+    g_workerPool *pool)
+{
+    corto_depresolver data = pool->data;
+
+    while (pool->next < pool->size) {
+        g_frontierItem *fi = &data->frontier[pool->next ++];
+        ut_mutex_unlock(&pool->lock);
+        g_frontierItemPrint(fi, data);
+        ut_mutex_lock(&pool->lock);
+        if (++ pool->finished == pool->size) {
+            ut_cond_signal(&pool->done);
+        }
+    }
+}
+
+/* Worker thread */
+static
+void* g_workerMain(
+    void *arg)
+{
+    g_workerPool *pool = arg;
+    corto_uint32 generation = 0;
+
+    ut_mutex_lock(&pool->lock);
+    while (TRUE) {
+        while (!pool->quit && pool->generation == generation) {
+            ut_cond_wait(&pool->start, &pool->lock);
+        }
+        if (pool->quit) {
+            break;
+        }
+        generation = pool->generation;
+        g_workerPoolRun(pool);
+    }
+    ut_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+/* Start worker threads. The walking thread is one of the workers. */
+static
+g_workerPool* g_workerPoolNew(
+    corto_depresolver data)
+{
+    corto_uint32 i;
+    g_workerPool *pool = corto_calloc(sizeof(g_workerPool));
+
+    pool->data = data;
+    pool->count = data->workers - 1;
+    pool->threads = corto_alloc(pool->count * sizeof(ut_thread));
+    ut_mutex_new(&pool->lock);
+    ut_cond_new(&pool->start);
+    ut_cond_new(&pool->done);
+
+    for (i = 0; i < pool->count; i ++) {
+        pool->threads[i] = ut_thread_new(g_workerMain, pool);
+    }
+
+    return pool;
+}
+
+/* Stop worker threads */
+static
+void g_workerPoolFree(
+    g_workerPool *pool)
+{
+    corto_uint32 i;
+
+    ut_mutex_lock(&pool->lock);
+    pool->quit = TRUE;
+    ut_cond_broadcast(&pool->start);
+    ut_mutex_unlock(&pool->lock);
+
+    for (i = 0; i < pool->count; i ++) {
+        ut_thread_join(pool->threads[i], NULL);
+    }
+
+    ut_cond_free(&pool->start);
+    ut_cond_free(&pool->done);
+    ut_mutex_free(&pool->lock);
+    corto_dealloc(pool->threads);
+    corto_dealloc(pool);
+}
+
+/* Execute callbacks for all items in frontier, and wait until done */
+static
+void g_workerPoolExecute(
+    g_workerPool *pool)
+{
+    corto_depresolver data = pool->data;
+    ut_mutex_lock(&pool->lock);
+    pool->size = data->frontierCount;
+    pool->next = 0;
+    pool->finished = 0;
+    pool->generation ++;
+    ut_cond_broadcast(&pool->start);
+
+    g_workerPoolRun(pool);
+
+    while (pool->finished != pool->size) {
+        ut_cond_wait(&pool->done, &pool->lock);
+    }
+
+    /* Workers that wake up late must not pick up items of the next frontier
+     * while it is being collected. */
+    pool->size = 0;
+    ut_mutex_unlock(&pool->lock);
+}
+
+/* Print items in frontiers. A frontier contains all items that are ready to
+ * be printed. Callbacks for items in a frontier do not depend on each other
+ * and are executed in parallel. Dependencies are resolved afterwards by the
+ * walking thread, in frontier order, so the sequence of frontiers is the same
+ * for every walk. */
+static
+int g_itemPrintFrontiers(struct corto_depresolver_s* data) {
+    corto_uint32 i;
+
+    while (data->toPrintCount) {
+        data->frontierCount = 0;
+
+        /* Plan declare and define actions for items in frontier. Items are
+         * marked as declared and defined here, so that an item that is on the
+         * stack twice is only printed once. */
+        while (data->toPrintCount) {
+            corto_uint32 item = g_itemPop(data);
+            g_itemState *state = &data->state[item];
+            corto_bool declare = FALSE, define = FALSE;
+
+            if (!state->declared && !state->declareCount) {
+                state->declared = TRUE;
+                state->declareOrder = ++ data->sequence;
+                declare = TRUE;
+            }
+            if (state->declared && !state->defined && !state->defineCount) {
+                state->defined = TRUE;
+                state->defineOrder = ++ data->sequence;
+                define = TRUE;
+            }
+
+            if (declare || define) {
+                g_frontierItem *fi;
+                if (data->frontierCount == data->frontierSize) {
+                    data->frontierSize = data->frontierSize
+                        ? data->frontierSize * 2
+                        : G_STACK_MIN_SIZE;
+                    data->frontier = corto_realloc(data->frontier,
+                        data->frontierSize * sizeof(g_frontierItem));
+                }
+                fi = &data->frontier[data->frontierCount ++];
+                fi->item = item;
+                fi->declare = declare;
+                fi->define = define;
+            }
+        }
+
+        /* Execute callbacks. Small frontiers are not worth waking up the
+         * workers for. */
+        if (data->frontierCount > 1) {
+            g_workerPoolExecute(data->pool);
+        } else if (data->frontierCount) {
+            g_frontierItemPrint(&data->frontier[0], data);
+        }
+
+        /* Resolve dependencies of printed items */
+        for (i = 0; i < data->frontierCount; i ++) {
+            g_frontierItem *fi = &data->frontier[i];
+            corto_uint32 *offsets = &data->offsets[2 * fi->item];
+            if (fi->declare) {
+                G_TRACE(data, G_TRACE_DECLARE, fi->item, 0, 0);
+                g_itemResolveDependencies(
+                    fi->item, offsets[0], offsets[1], data);
+            }
+            if (fi->define) {
+                G_TRACE(data, G_TRACE_DEFINE, fi->item, 0, 0);
+                g_itemResolveDependencies(
+                    fi->item, offsets[1], offsets[2], data);
+            }
+        }
+    }
+
+    return 0;
+}
+
+/* Break weak dependency to resolve a cycle */
+static
+void g_itemBreakDependency(
+    corto_uint32 item,
+    corto_uint32 e,
+    corto_depresolver data)
+{
+    corto_uint32 edge = data->edges[e];
+
+    G_TRACE(data, G_TRACE_BREAK, item, G_EDGE_ITEM(edge), edge);
+
+    g_itemResolveDependency(item, e, data);
+    data->edges[e] |= G_EDGE_BROKEN;
+    data->brokenCount ++;
+}
+
+/* Frame of the explicit DFS stack used by cycle detection */
+typedef struct g_sccFrame {
+    corto_uint32 item;
+    corto_uint32 next; /* Next edge to visit */
+    corto_uint32 end;
+} g_sccFrame;
+
+/* Get next unresolved dependency of item on DFS stack. Returns FALSE if all
+ * dependencies have been visited. */
+static
+corto_bool g_sccNextDependency(
+    g_sccFrame *frame,
+    corto_uint32 *dependent,
+    struct corto_depresolver_s* data)
+{
+    while (frame->next < frame->end) {
+        corto_uint32 edge = data->edges[frame->next ++];
+        if (!(edge & G_EDGE_PROCESSED) &&
+            !data->state[G_EDGE_ITEM(edge)].defined)
+        {
+            *dependent = G_EDGE_ITEM(edge);
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/* Push item on SCC stack and on DFS stack */
+static
+void g_sccVisit(
+    corto_uint32 item,
+    corto_uint32 *fp,
+    struct corto_depresolver_s* data)
+{
+    g_itemState *state = &data->state[item];
+    g_sccFrame *frame;
+
+    if (data->sccSp == data->sccStackSize) {
+        data->sccStackSize *= 2;
+        data->sccStack = corto_realloc(
+            data->sccStack, data->sccStackSize * sizeof(corto_uint32));
+    }
+    if (*fp == data->framesSize) {
+        data->framesSize *= 2;
+        data->frames = corto_realloc(
+            data->frames, data->framesSize * sizeof(g_sccFrame));
+    }
+
+    state->sccIteration = data->iteration;
+    state->sccIndex = state->sccLowlink = ++ data->sccIndex;
+    state->sccOnStack = TRUE;
+    data->sccStack[data->sccSp ++] = item;
+
+    /* If an item has been declared, the dependencies that are resolved by
+     * declaring it have already been resolved, and likewise for defined. */
+    frame = &data->frames[(*fp) ++];
+    frame->item = item;
+    if (state->defined) {
+        frame->next = frame->end = 0;
+    } else {
+        frame->next = data->offsets[2 * item + (state->declared ? 1 : 0)];
+        frame->end = data->offsets[2 * item + 2];
+    }
+}
+
+/* Break a cycle in a component that cannot be ordered, because it has cycles
+ * of dependencies that cannot be broken or depends on items that cannot be
+ * printed. The first weak dependency between members that is found is broken,
+ * so that the next pass can make progress. A weak dependency can only be
+ * broken if its dependency has been declared. Returns TRUE if a dependency
+ * was broken. */
+static
+corto_bool g_sccBreak(
+    corto_uint32 *members,
+    corto_uint32 count,
+    corto_uint32 component,
+    struct corto_depresolver_s* data)
+{
+    corto_uint32 i, e;
+
+    for (i = 0; i < count; i ++) {
+        corto_uint32 item = members[i], end;
+
+        if (!data->state[item].declared) {
+            continue;
+        }
+
+        end = data->offsets[2 * item + 2];
+        for (e = data->offsets[2 * item + 1]; e < end; e ++) {
+            corto_uint32 edge = data->edges[e];
+            g_itemState *dependent = &data->state[G_EDGE_ITEM(edge)];
+            if ((edge & G_EDGE_WEAK) && !(edge & G_EDGE_PROCESSED) &&
+                dependent->sccComponent == component && !dependent->defined)
+            {
+                g_itemBreakDependency(item, e, data);
+
+                /* The dependency is now processed, so it cannot be weakened
+                 * again. The weak flag is kept for the next walk. */
+                return TRUE;
+            }
+        }
+    }
+
+    return FALSE;
+}
+
+/* Push member on heap of members that are not ordered */
+static
+void g_mfasPush(
+    g_mfas *m,
+    corto_uint32 node)
+{
+    g_mfasNode *n = &m->nodes[node];
+    corto_int64 delta = n->outWeight - n->inWeight;
+    corto_uint32 i;
+
+    if (m->heapCount == m->heapSize) {
+        m->heapSize = m->heapSize ? m->heapSize * 2 : G_STACK_MIN_SIZE;
+        m->heap = corto_realloc(m->heap, m->heapSize * sizeof(g_mfasEntry));
+    }
+
+    for (i = m->heapCount ++; i; ) {
+        corto_uint32 parent = (i - 1) / 2;
+        if (m->heap[parent].delta >= delta) {
+            break;
+        }
+        m->heap[i] = m->heap[parent];
+        i = parent;
+    }
+
+    m->heap[i].delta = delta;
+    m->heap[i].node = node;
+}
+
+/* Pop member with the largest difference between dependents and dependencies.
+ * Entries of members that are already ordered or have changed are skipped. */
+static
+corto_uint32 g_mfasPop(
+    g_mfas *m)
+{
+    while (m->heapCount) {
+        g_mfasEntry top = m->heap[0];
+        g_mfasEntry last = m->heap[-- m->heapCount];
+        g_mfasNode *n = &m->nodes[top.node];
+        corto_uint32 i = 0;
+
+        while (2 * i + 1 < m->heapCount) {
+            corto_uint32 child = 2 * i + 1;
+            if (child + 1 < m->heapCount &&
+                m->heap[child + 1].delta > m->heap[child].delta)
+            {
+                child ++;
+            }
+            if (m->heap[child].delta <= last.delta) {
+                break;
+            }
+            m->heap[i] = m->heap[child];
+            i = child;
+        }
+        if (m->heapCount) {
+            m->heap[i] = last;
+        }
+
+        if (!n->ordered && top.delta == n->outWeight - n->inWeight) {
+            return top.node;
+        }
+    }
+
+    ut_assert(0, "no member left to order");
+    return 0;
+}
+
+/* Allocate administration for a component of count members */
+static
+void g_mfasReserve(
+    g_mfas *m,
+    corto_uint32 count)
+{
+    if (count > m->nodesSize) {
+        m->nodesSize = count;
+        m->nodes = corto_realloc(m->nodes, count * sizeof(g_mfasNode));
+        m->outOffsets = corto_realloc(
+            m->outOffsets, (count + 1) * sizeof(corto_uint32));
+        m->inOffsets = corto_realloc(
+            m->inOffsets, (count + 1) * sizeof(corto_uint32));
+        m->sources = corto_realloc(m->sources, count * sizeof(corto_uint32));
+        m->sinks = corto_realloc(m->sinks, count * sizeof(corto_uint32));
+    }
+}
+
+/* Add edge between members of component */
+static
+void g_mfasAddEdge(
+    g_mfas *m,
+    corto_uint32 from,
+    corto_uint32 to,
+    corto_uint32 edge,
+    corto_bool breakable)
+{
+    g_mfasEdge *e;
+
+    if (m->edgeCount == m->edgesSize) {
+        m->edgesSize = m->edgesSize ? m->edgesSize * 2 : G_STACK_MIN_SIZE;
+        m->edges = corto_realloc(m->edges, m->edgesSize * sizeof(g_mfasEdge));
+        m->out = corto_realloc(m->out, m->edgesSize * sizeof(corto_uint32));
+        m->in = corto_realloc(m->in, m->edgesSize * sizeof(corto_uint32));
+    }
+
+    e = &m->edges[m->edgeCount ++];
+    e->from = from;
+    e->to = to;
+    e->edge = edge;
+    e->breakable = breakable;
+}
+
+/* Order member, and update the members it is connected with */
+static
+void g_mfasOrder(
+    g_mfas *m,
+    corto_uint32 node,
+    corto_uint32 rank,
+    corto_int64 weight,
+    corto_uint32 *sourceCount,
+    corto_uint32 *sinkCount)
+{
+    corto_uint32 i;
+
+    m->nodes[node].ordered = TRUE;
+    m->nodes[node].rank = rank;
+
+    for (i = m->outOffsets[node]; i < m->outOffsets[node + 1]; i ++) {
+        g_mfasEdge *e = &m->edges[m->out[i]];
+        g_mfasNode *n = &m->nodes[e->to];
+        if (!n->ordered) {
+            n->inCount --;
+            n->inWeight -= e->breakable ? 1 : weight;
+            if (!n->inCount) {
+                m->sources[(*sourceCount) ++] = e->to;
+            } else {
+                g_mfasPush(m, e->to);
+            }
+        }
+    }
+
+    for (i = m->inOffsets[node]; i < m->inOffsets[node + 1]; i ++) {
+        g_mfasEdge *e = &m->edges[m->in[i]];
+        g_mfasNode *n = &m->nodes[e->from];
+        if (!n->ordered) {
+            n->outCount --;
+            n->outWeight -= e->breakable ? 1 : weight;
+            if (!n->outCount) {
+                m->sinks[(*sinkCount) ++] = e->from;
+            } else {
+                g_mfasPush(m, e->from);
+            }
+        }
+    }
+}
+
+/* Rank the members of a component, so that as few weak dependencies as
+ * possible go against the order. Finding the smallest set of dependencies that
+ * breaks all cycles (a minimum feedback arc set) is NP-hard, so members are
+ * ordered with the heuristic of Eades, Lin and Smyth: members without
+ * dependencies go first, members without dependents go last, and otherwise
+ * the member with most dependents relative to its dependencies goes first.
+ * Dependencies that cannot be broken weigh more than all weak dependencies
+ * together, so they are kept in order where possible. Members must have their
+ * index in the component in sccMember. */
+static
+void g_mfasRank(
+    corto_uint32 *members,
+    corto_uint32 count,
+    corto_uint32 component,
+    struct corto_depresolver_s* data)
+{
+    g_mfas *m = &data->mfas;
+    corto_uint32 i, e, breakable = 0;
+    corto_uint32 low = 0, high = count, sourceCount = 0, sinkCount = 0;
+    corto_int64 weight;
+
+    g_mfasReserve(m, count);
+    for (i = 0; i < count; i ++) {
+        memset(&m->nodes[i], 0, sizeof(g_mfasNode));
+    }
+
+    /* Collect unresolved dependencies between members */
+    m->edgeCount = 0;
+    for (i = 0; i < count; i ++) {
+        corto_uint32 item = members[i];
+        g_itemState *state = &data->state[item];
+        corto_uint32 end = data->offsets[2 * item + 2];
+
+        for (e = data->offsets[2 * item + (state->declared ? 1 : 0)]; e < end; e ++) {
+            corto_uint32 edge = data->edges[e];
+            g_itemState *dependent = &data->state[G_EDGE_ITEM(edge)];
+            if (!(edge & G_EDGE_PROCESSED) && !dependent->defined &&
+                dependent->sccComponent == component)
+            {
+                corto_bool b = (edge & G_EDGE_WEAK) != 0;
+                g_mfasAddEdge(m, i, dependent->sccMember, e, b);
+                breakable += b;
+            }
+        }
+    }
+
+    /* Index edges by member */
+    weight = (corto_int64)breakable + 1;
+    memset(m->outOffsets, 0, (count + 1) * sizeof(corto_uint32));
+    memset(m->inOffsets, 0, (count + 1) * sizeof(corto_uint32));
+    for (e = 0; e < m->edgeCount; e ++) {
+        g_mfasEdge *edge = &m->edges[e];
+        corto_int64 w = edge->breakable ? 1 : weight;
+        m->nodes[edge->from].outCount ++;
+        m->nodes[edge->from].outWeight += w;
+        m->nodes[edge->to].inCount ++;
+        m->nodes[edge->to].inWeight += w;
+        m->outOffsets[edge->from + 1] ++;
+        m->inOffsets[edge->to + 1] ++;
+    }
+    for (i = 0; i < count; i ++) {
+        m->outOffsets[i + 1] += m->outOffsets[i];
+        m->inOffsets[i + 1] += m->inOffsets[i];
+    }
+    for (e = 0; e < m->edgeCount; e ++) {
+        g_mfasEdge *edge = &m->edges[e];
+        m->out[m->outOffsets[edge->from] ++] = e;
+        m->in[m->inOffsets[edge->to] ++] = e;
+    }
+    for (i = count; i; i --) {
+        m->outOffsets[i] = m->outOffsets[i - 1];
+        m->inOffsets[i] = m->inOffsets[i - 1];
+    }
+    m->outOffsets[0] = m->inOffsets[0] = 0;
+
+    /* Order members */
+    m->heapCount = 0;
+    for (i = 0; i < count; i ++) {
+        g_mfasPush(m, i);
+    }
+    while (low < high) {
+        corto_uint32 node;
+        if (sinkCount) {
+            node = m->sinks[-- sinkCount];
+            if (!m->nodes[node].ordered) {
+                g_mfasOrder(m, node, -- high, weight, &sourceCount, &sinkCount);
+            }
+        } else if (sourceCount) {
+            node = m->sources[-- sourceCount];
+            if (!m->nodes[node].ordered) {
+                g_mfasOrder(m, node, low ++, weight, &sourceCount, &sinkCount);
+            }
+        } else {
+            node = g_mfasPop(m);
+            g_mfasOrder(m, node, low ++, weight, &sourceCount, &sinkCount);
+        }
+    }
+}
+
+/* Allocate order administration for a component of count members */
+static
+void g_sccOrderReserve(
+    g_sccOrder *o,
+    corto_uint32 count)
+{
+    if (count > o->eventSize) {
+        o->eventSize = count;
+        o->offsets = corto_realloc(
+            o->offsets, (2 * count + 2) * sizeof(corto_uint32));
+        o->inCount = corto_realloc(
+            o->inCount, 2 * count * sizeof(corto_uint32));
+        o->weakCount = corto_realloc(
+            o->weakCount, 2 * count * sizeof(corto_uint32));
+        o->blocked = corto_realloc(
+            o->blocked, 2 * count * sizeof(corto_uint32));
+        o->position = corto_realloc(
+            o->position, 2 * count * sizeof(corto_uint32));
+        o->heap = corto_realloc(o->heap, 2 * count * sizeof(corto_uint32));
+        o->byPriority = corto_realloc(
+            o->byPriority, count * sizeof(corto_uint32));
+    }
+}
+
+/* Event 'to' must be ordered after event 'from' */
+static
+void g_sccConstrain(
+    g_sccOrder *o,
+    corto_uint32 from,
+    corto_uint32 to)
+{
+    if (o->constraintCount == o->constraintSize) {
+        o->constraintSize = o->constraintSize
+            ? o->constraintSize * 2
+            : G_STACK_MIN_SIZE;
+        o->from = corto_realloc(
+            o->from, o->constraintSize * sizeof(corto_uint32));
+        o->to = corto_realloc(o->to, o->constraintSize * sizeof(corto_uint32));
+        o->targets = corto_realloc(
+            o->targets, o->constraintSize * sizeof(corto_uint32));
+    }
+
+    o->from[o->constraintCount] = from;
+    o->to[o->constraintCount] = to;
+    o->constraintCount ++;
+}
+
+/* Add weak dependency that may be broken */
+static
+void g_sccCandidateAdd(
+    g_sccOrder *o,
+    corto_uint32 edge,
+    corto_uint32 item,
+    corto_uint32 event)
+{
+    g_sccCandidate *c;
+
+    if (o->candidateCount == o->candidateSize) {
+        o->candidateSize = o->candidateSize
+            ? o->candidateSize * 2
+            : G_STACK_MIN_SIZE;
+        o->candidates = corto_realloc(
+            o->candidates, o->candidateSize * sizeof(g_sccCandidate));
+        o->sorted = corto_realloc(
+            o->sorted, o->candidateSize * sizeof(g_sccCandidate));
+    }
+
+    c = &o->candidates[o->candidateCount ++];
+    c->edge = edge;
+    c->item = item;
+    c->event = event;
+}
+
+/* Push key on heap of events that can be ordered. Keys are the priority of
+ * the member times two, plus one for a define. */
+static
+void g_sccHeapPush(
+    corto_uint32 *heap,
+    corto_uint32 *count,
+    corto_uint32 key)
+{
+    corto_uint32 i = (*count) ++;
+
+    while (i) {
+        corto_uint32 parent = (i - 1) / 2;
+        if (heap[parent] <= key) {
+            break;
+        }
+        heap[i] = heap[parent];
+        i = parent;
+    }
+    heap[i] = key;
+}
+
+/* Pop key with the highest priority */
+static
+corto_uint32 g_sccHeapPop(
+    corto_uint32 *heap,
+    corto_uint32 *count)
+{
+    corto_uint32 result = heap[0], last = heap[-- (*count)], i = 0;
+
+    while (2 * i + 1 < *count) {
+        corto_uint32 child = 2 * i + 1;
+        if (child + 1 < *count && heap[child + 1] < heap[child]) {
+            child ++;
+        }
+        if (last <= heap[child]) {
+            break;
+        }
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = last;
+
+    return result;
+}
+
+/* Event can be ordered after the events it waits for */
+static
+void g_sccReady(
+    g_sccOrder *o,
+    corto_uint32 event,
+    corto_bool minimal,
+    corto_uint32 *heapCount,
+    corto_uint32 *blockedCount,
+    struct corto_depresolver_s* data)
+{
+    corto_uint32 member = event / 2;
+    corto_uint32 priority = minimal ? data->mfas.nodes[member].rank : member;
+    corto_uint32 key = 2 * priority + (event & 1);
+
+    if (o->weakCount[event]) {
+        g_sccHeapPush(o->blocked, blockedCount, key);
+    } else {
+        g_sccHeapPush(o->heap, heapCount, key);
+    }
+}
+
+/* Resolve the cycles of a strongly connected component in one pass. The
+ * events of the members that have not been printed are ordered such that
+ * dependencies that cannot be broken are respected, and a weak dependency is
+ * only broken after its dependency is declared. Of the events that can be
+ * ordered, the events of the member that was found first go first, or, with
+ * CORTO_DEPRESOLVER_MINIMAL_BREAK, the member with the best rank.
+ *
+ * The weak dependencies that go against the order are then visited in the
+ * order of their dependents. A dependency is only broken if printing did not
+ * resolve it yet, and the items that become ready are printed right away. All
+ * events before the dependent are printed by then, so the dependency is
+ * declared, and the dependent only waits for weak dependencies that go
+ * against the order. This visits every member and dependency of the component
+ * a constant number of times, regardless of how many dependencies are
+ * broken. Returns -1 if printing failed. */
+static
+int g_sccResolve(
+    corto_uint32 *members,
+    corto_uint32 count,
+    corto_uint32 component,
+    corto_uint32 *broken,
+    struct corto_depresolver_s* data)
+{
+    g_sccOrder *o = &data->order;
+    corto_bool minimal = (data->flags & CORTO_DEPRESOLVER_MINIMAL_BREAK) != 0;
+    corto_uint32 events = 2 * count, heapCount = 0, blockedCount = 0;
+    corto_uint32 ordered = 0;
+    corto_uint32 i, e, c, candidateCount = 0;
+
+    G_TRACE(data, G_TRACE_CYCLE, members[0], count, 0);
+
+    g_sccOrderReserve(o, count);
+    for (i = 0; i < count; i ++) {
+        data->state[members[i]].sccMember = i;
+    }
+
+    /* Collect constraints between events that have not been printed, and the
+     * weak dependencies that may be broken */
+    o->constraintCount = 0;
+    o->candidateCount = 0;
+    for (i = 0; i < count; i ++) {
+        corto_uint32 item = members[i];
+        g_itemState *state = &data->state[item];
+        corto_uint32 define = data->offsets[2 * item + 1];
+        corto_uint32 end = data->offsets[2 * item + 2];
+
+        if (state->defined) {
+            continue;
+        }
+
+        /* An item is declared before it is defined */
+        if (!state->declared) {
+            g_sccConstrain(o, 2 * i, 2 * i + 1);
+        }
+
+        e = state->declared ? define : data->offsets[2 * item];
+        for (; e < end; e ++) {
+            corto_uint32 edge = data->edges[e], target;
+            g_itemState *dependent = &data->state[G_EDGE_ITEM(edge)];
+
+            if ((edge & G_EDGE_PROCESSED) || dependent->defined ||
+                dependent->sccComponent != component)
+            {
+                continue;
+            }
+
+            target = 2 * dependent->sccMember + !(edge & G_EDGE_DECLARE);
+            if ((edge & G_EDGE_WEAK) && e >= define) {
+                g_sccCandidateAdd(o, e, item, target);
+                g_sccConstrain(o, 2 * i + 1, target | G_SCC_WEAK);
+                if (!state->declared) {
+                    g_sccConstrain(o, 2 * i, target);
+                }
+            } else {
+                g_sccConstrain(o, 2 * i + (e >= define), target);
+            }
+        }
+    }
+
+    /* Index constraints by event */
+    memset(o->offsets, 0, (events + 1) * sizeof(corto_uint32));
+    memset(o->inCount, 0, events * sizeof(corto_uint32));
+    memset(o->weakCount, 0, events * sizeof(corto_uint32));
+    for (c = 0; c < o->constraintCount; c ++) {
+        corto_uint32 to = o->to[c];
+        o->offsets[o->from[c] + 1] ++;
+        if (to & G_SCC_WEAK) {
+            o->weakCount[to & ~G_SCC_WEAK] ++;
+        } else {
+            o->inCount[to] ++;
+        }
+    }
+    for (i = 0; i < events; i ++) {
+        o->offsets[i + 1] += o->offsets[i];
+    }
+    for (c = 0; c < o->constraintCount; c ++) {
+        o->targets[o->offsets[o->from[c]] ++] = o->to[c];
+    }
+    for (i = events; i; i --) {
+        o->offsets[i] = o->offsets[i - 1];
+    }
+    o->offsets[0] = 0;
+
+    /* Order events. Events that only wait for weak dependencies are ordered
+     * when no other event can be ordered, which breaks those dependencies.
+     * Events that are printed or that are in a cycle of dependencies that
+     * cannot be broken are not ordered. */
+    if (minimal) {
+        g_mfasRank(members, count, component, data);
+    }
+    for (i = 0; i < count; i ++) {
+        o->byPriority[minimal ? data->mfas.nodes[i].rank : i] = i;
+    }
+    for (i = 0; i < events; i ++) {
+        g_itemState *state = &data->state[members[i / 2]];
+        o->position[i] = events;
+        if (!o->inCount[i] && !((i & 1) ? state->defined : state->declared)) {
+            g_sccReady(o, i, minimal, &heapCount, &blockedCount, data);
+        }
+    }
+    while (heapCount || blockedCount) {
+        corto_uint32 key = heapCount
+            ? g_sccHeapPop(o->heap, &heapCount)
+            : g_sccHeapPop(o->blocked, &blockedCount);
+        corto_uint32 event = 2 * o->byPriority[key / 2] + (key & 1);
+
+        /* Blocked event may have been ordered after its weak dependencies */
+        if (o->position[event] != events) {
+            continue;
+        }
+
+        o->position[event] = ordered ++;
+        for (c = o->offsets[event]; c < o->offsets[event + 1]; c ++) {
+            corto_uint32 target = o->targets[c];
+            if (target & G_SCC_WEAK) {
+                target &= ~G_SCC_WEAK;
+                if (!-- o->weakCount[target] && !o->inCount[target] &&
+                    o->position[target] == events)
+                {
+                    g_sccReady(
+                        o, target, minimal, &heapCount, &blockedCount, data);
+                }
+            } else if (!-- o->inCount[target]) {
+                g_sccReady(o, target, minimal, &heapCount, &blockedCount, data);
+            }
+        }
+    }
+
+    /* Sort weak dependencies that go against the order by the position of
+     * their dependent. Dependents that are not ordered cannot be printed by
+     * breaking weak dependencies only. */
+    memset(o->offsets, 0, (events + 1) * sizeof(corto_uint32));
+    for (c = 0; c < o->candidateCount; c ++) {
+        g_sccCandidate *cand = &o->candidates[c];
+        corto_uint32 position = o->position[cand->event];
+        corto_uint32 member = data->state[cand->item].sccMember;
+        if (position < events && o->position[2 * member + 1] > position) {
+            o->offsets[position + 1] ++;
+            candidateCount ++;
+        }
+    }
+    for (i = 0; i < events; i ++) {
+        o->offsets[i + 1] += o->offsets[i];
+    }
+    for (c = 0; c < o->candidateCount; c ++) {
+        g_sccCandidate *cand = &o->candidates[c];
+        corto_uint32 position = o->position[cand->event];
+        corto_uint32 member = data->state[cand->item].sccMember;
+        if (position < events && o->position[2 * member + 1] > position) {
+            o->sorted[o->offsets[position] ++] = *cand;
+        }
+    }
+
+    /* Break weak dependencies that are not resolved by printing */
+    for (c = 0; c < candidateCount; c ++) {
+        g_sccCandidate *cand = &o->sorted[c];
+
+        if (data->edges[cand->edge] & G_EDGE_PROCESSED) {
+            continue;
+        }
+
+        /* Component depends on items that cannot be printed */
+        if (!data->state[cand->item].declared) {
+            break;
+        }
+
+        g_itemBreakDependency(cand->item, cand->edge, data);
+        (*broken) ++;
+
+        if (data->toPrintCount) {
+            struct timespec start;
+            ut_time_get(&start);
+            if (g_itemPrintItems(data)) {
+                goto error;
+            }
+            data->emitTime += g_elapsed(&start);
+        }
+    }
+
+    /* Members that are not printed yet are in cycles that cannot be broken,
+     * or depend on items that cannot be printed */
+    for (i = 0; i < count; i ++) {
+        if (!data->state[members[i]].defined) {
+            if (g_sccBreak(members, count, component, data)) {
+                (*broken) ++;
+            } else {
+                G_TRACE(data, G_TRACE_NO_BREAK, members[0], count, 0);
+            }
+            break;
+        }
+    }
+
+    return 0;
+error:
+    return -1;
+}
+
+/* Resolve cycles.
+ *
+ * If there are cycles, the only cycles that can be broken are the DECLARED | DEFINED dependencies, which
+ * are stored as edges with the weak flag set.
+ *
+ * Cycles are found with an iterative version of Tarjan's strongly connected
+ * components algorithm, which visits every unresolved item and dependency
+ * once. Components are found in reverse dependency order, so they are
+ * resolved in the opposite order after all components are found. This way the
+ * items a component depends on are printed before its cycles are broken.
+ * Only components that cannot be resolved in one pass require another pass,
+ * so the caller repeats this until no more dependencies are broken.
+ */
+static
+int g_itemResolveCycles(
+    struct corto_depresolver_s* data,
+    corto_uint32 *broken)
+{
+    g_sccOrder *o = &data->order;
+    corto_uint32 r, first = o->component + 1;
+
+    data->iteration ++;
+    data->sccIndex = 0;
+    data->sccSp = 0;
+    o->memberCount = 0;
+    o->componentCount = 0;
+
+    for (r = 0; r < data->walkCount; r ++) {
+        corto_uint32 root = data->walkItems[r];
+        corto_uint32 fp = 0;
+
+        if (data->state[root].defined ||
+            data->state[root].sccIteration == data->iteration)
+        {
+            continue;
+        }
+
+        g_sccVisit(root, &fp, data);
+
+        while (fp) {
+            g_sccFrame *frame = &data->frames[fp - 1];
+            corto_uint32 item = frame->item, next;
+            g_itemState *state = &data->state[item];
+
+            if (g_sccNextDependency(frame, &next, data)) {
+                g_itemState *nextState = &data->state[next];
+                if (nextState->sccIteration != data->iteration) {
+                    g_sccVisit(next, &fp, data);
+                } else if (nextState->sccOnStack && nextState->sccIndex < state->sccLowlink) {
+                    state->sccLowlink = nextState->sccIndex;
+                }
+                continue;
+            }
+
+            /* All dependencies of item are visited, pop it from DFS stack */
+            fp --;
+            if (fp) {
+                g_itemState *parent = &data->state[data->frames[fp - 1].item];
+                if (state->sccLowlink < parent->sccLowlink) {
+                    parent->sccLowlink = state->sccLowlink;
+                }
+            }
+
+            /* If item is the root of a component, pop it from SCC stack */
+            if (state->sccLowlink == state->sccIndex) {
+                corto_uint32 start = data->sccSp, size, i;
+
+                do {
+                    start --;
+                } while (data->sccStack[start] != item);
+
+                size = data->sccSp - start;
+                if (size > 1) {
+                    if (data->sccCounting) {
+                        data->sccCount ++;
+                        data->sccItems += size;
+                        if (size > data->sccMaxSize) {
+                            data->sccMaxSize = size;
+                        }
+                    }
+
+                    /* Store members of component */
+                    if (o->componentCount == o->componentSize) {
+                        o->componentSize = o->componentSize
+                            ? o->componentSize * 2
+                            : G_STACK_MIN_SIZE;
+                        o->components = corto_realloc(o->components,
+                            (o->componentSize + 1) * sizeof(corto_uint32));
+                    }
+                    if (o->memberCount + size > o->memberSize) {
+                        while (o->memberCount + size > o->memberSize) {
+                            o->memberSize = o->memberSize
+                                ? o->memberSize * 2
+                                : G_STACK_MIN_SIZE;
+                        }
+                        o->members = corto_realloc(o->members,
+                            o->memberSize * sizeof(corto_uint32));
+                    }
+                    o->components[o->componentCount ++] = o->memberCount;
+                    o->component ++;
+                    for (i = start; i < data->sccSp; i ++) {
+                        corto_uint32 member = data->sccStack[i];
+                        data->state[member].sccComponent = o->component;
+                        o->members[o->memberCount ++] = member;
+                    }
+                }
+
+                for (i = start; i < data->sccSp; i ++) {
+                    data->state[data->sccStack[i]].sccOnStack = FALSE;
+                }
+                data->sccSp = start;
+            }
+        }
+    }
+
+    /* Resolve components, starting with the components that other components
+     * depend on */
+    if (o->componentCount) {
+        o->components[o->componentCount] = o->memberCount;
+    }
+    for (r = o->componentCount; r > 0; r --) {
+        corto_uint32 start = o->components[r - 1];
+        if (g_sccResolve(&o->members[start], o->components[r] - start,
+            first + r - 1, broken, data))
+        {
+            goto error;
+        }
+    }
+
+    return 0;
+error:
+    return -1;
+}
+
+void corto_depresolver_opt_init(
+    corto_depresolver_opt *opt)
+{
+    memset(opt, 0, sizeof(corto_depresolver_opt));
+}
+
+/* Walk objects in correct dependency order. */
+corto_depresolver corto_depresolverCreate(
+    corto_depresolver_action onDeclare,
+    corto_depresolver_action onDefine,
+    void* userData)
+{
+    corto_depresolver_opt opt;
+
+    corto_depresolver_opt_init(&opt);
+    opt.onDeclare = onDeclare;
+    opt.onDefine = onDefine;
+    opt.userData = userData;
+
+    return corto_depresolverCreateExt(&opt);
+}
+
+/* Name of object for diagnostics and ordering. Anonymous objects have no
+ * stable name. */
+static
+char* g_objectName(
+    void *o,
+    void *userData)
+{
+    corto_id id;
+    CORTO_UNUSED(userData);
+
+    if (!corto_check_attr(o, CORTO_ATTR_NAMED)) {
+        return NULL;
+    }
+
+    return ut_strdup(corto_fullpath(id, o));
+}
+
+corto_depresolver corto_depresolverCreateExt(
+    corto_depresolver_opt *opt)
+{
+    corto_depresolver_opt objectOpt = *opt;
+
+    if (!objectOpt.name) {
+        objectOpt.name = g_objectName;
+    }
+    if (!objectOpt.root) {
+        objectOpt.root = root_o;
+    }
+
+    return corto_depresolverCreateGeneric(&objectOpt);
+}
+
+corto_depresolver corto_depresolverCreateGeneric(
+    corto_depresolver_opt *opt)
+{
+    corto_depresolver result;
+
+    result = corto_alloc(sizeof(struct corto_depresolver_s));
+
+    memset(&result->arena, 0, sizeof(g_arena));
+    result->items = NULL;
+    result->toPrintSize = G_STACK_MIN_SIZE;
+    result->toPrint = corto_alloc(result->toPrintSize * sizeof(corto_uint32));
+    result->toPrintCount = 0;
+    result->onDeclare = opt->onDeclare;
+    result->onDefine = opt->onDefine;
+    result->userData = opt->userData;
+    result->compare = opt->compare;
+    result->hash = opt->hash;
+    result->equals = opt->equals;
+    result->name = opt->name;
+    result->keyData = opt->keyData;
+    result->root = opt->root;
+    result->rootIndex = 0;
+    result->frozen = FALSE;
+    result->count = 0;
+    result->countSize = 0;
+    result->objects = NULL;
+    result->state = NULL;
+    result->offsets = NULL;
+    result->edges = NULL;
+    result->edgeCount = 0;
+    result->edgeSize = 0;
+    result->walkItems = NULL;
+    result->walkCount = 0;
+    result->walkSize = 0;
+    result->walk = 0;
+    result->walked = FALSE;
+    result->dirty = NULL;
+    result->dirtyCount = 0;
+    result->dirtySize = 0;
+    result->flags = opt->flags;
+    result->workers = opt->workers;
+    result->frontier = NULL;
+    result->frontierCount = 0;
+    result->frontierSize = 0;
+    result->pool = NULL;
+    result->parallel = FALSE;
+    result->iteration = 0;
+    result->itemCount = 0;
+    result->framesSize = G_STACK_MIN_SIZE;
+    result->frames = corto_alloc(result->framesSize * sizeof(g_sccFrame));
+    result->sccStackSize = G_STACK_MIN_SIZE;
+    result->sccStack = corto_alloc(result->sccStackSize * sizeof(corto_uint32));
+    result->sccSp = 0;
+    result->sequence = 0;
+    result->declareEdges = 0;
+    result->defineEdges = 0;
+    result->weakEdges = 0;
+    result->brokenCount = 0;
+    result->reducedCount = 0;
+    result->sccCounting = FALSE;
+    result->sccCount = 0;
+    result->sccMaxSize = 0;
+    result->sccItems = 0;
+    result->buildTime = 0;
+    result->freezeTime = 0;
+    result->cycleTime = 0;
+    result->emitTime = 0;
+    ut_time_get(&result->created);
+    memset(&result->mfas, 0, sizeof(g_mfas));
+    memset(&result->order, 0, sizeof(g_sccOrder));
+    result->trace = NULL;
+    result->traceMask = 0;
+    result->traceCount = 0;
+    if (opt->traceSize) {
+        corto_uint32 size = 1;
+        while (size < opt->traceSize && size < (1u << 31)) {
+            size *= 2;
+        }
+        result->trace = corto_alloc(size * sizeof(g_traceEvent));
+        result->traceMask = size - 1;
+    }
+    g_indexInit(result, opt->capacity);
+    result->depIndexSize = G_INDEX_MIN_SIZE;
+    result->depIndex = corto_calloc(result->depIndexSize * sizeof(g_dependency));
+    result->depCount = 0;
+    result->duplicateCount = 0;
+
+    return result;
+}
+
+/* Insert dependency relation.
+ *   @param o The dependee object.
  *   @param kind Specifies whether the dependee potentially may be defined or declared after the dependency is resolved.
  *   @param dependency The dependency object.
  *   @param dependencyKind The dependency object must reach at least this state before the dependency can be resolved.
  */
+static
+void g_depend(
+    corto_depresolver this,
+    g_item dependent,
+    corto_state kind,
+    g_item dependency,
+    corto_state dependencyKind)
+{
+    g_dependency dep;
+
+    if (dependent != dependency) {
+        corto_uint32 slot = g_depIndexSlot(this->depIndex,
+            this->depIndexSize, dependent, kind, dependency, dependencyKind);
+
+        /* A dependency that already exists adds no information */
+        if (this->depIndex[slot]) {
+            this->duplicateCount ++;
+            return;
+        }
+
+        if (g_tableGrow(&this->depIndex, this->depCount, &this->depIndexSize,
+            sizeof(g_dependency), G_INDEX_MIN_SIZE, g_depIndexHash, NULL))
+        {
+            slot = g_depIndexSlot(this->depIndex, this->depIndexSize,
+                dependent, kind, dependency, dependencyKind);
+        }
+
+        /* Create dependency object */
+        dep = g_arenaAlloc(&this->arena, sizeof(struct g_dependency));
+        dep->kind = kind;
+        dep->item = dependent;
+        dep->dependency = dependency;
+        dep->dependencyKind = dependencyKind;
+        dep->weak = FALSE;
+
+        ut_assert(kind == CORTO_DECLARED || kind == CORTO_VALID,
+            "invalid dependee-kind.");
+
+        /* Insert in list of dependencies of dependent */
+        dep->nextDependsOn = dependent->dependsOn;
+        dependent->dependsOn = dep;
+        g_itemDirty(dependent, this);
+        this->frozen = FALSE;
+
+        /* Insert in corresponding list of dependency */
+        switch(dependencyKind) {
+        case CORTO_DECLARED:
+            dep->next = dependency->onDeclared;
+            dependency->onDeclared = dep;
+            break;
+        case CORTO_DECLARED | CORTO_VALID:
+            dep->weak = TRUE;
+            /* no break */
+        case CORTO_VALID:
+            dep->next = dependency->onDefined;
+            dependency->onDefined = dep;
+            break;
+        default:
+            ut_assert(0, "invalid dependency-kind (%d)", dependencyKind);
+            break;
+        }
+
+        this->depIndex[slot] = dep;
+        this->depCount ++;
+        g_dependencyCountKind(this, dep, 1);
+    }
+}
+
 void corto_depresolver_depend(
     corto_depresolver this,
     void* o,
@@ -451,139 +2627,1124 @@ void corto_depresolver_depend(
     void* d,
     corto_state dependencyKind)
 {
+    g_item dependent = g_itemLookup(o, this);
+    g_item dependency = g_itemLookup(d, this);
+    g_depend(this, dependent, kind, dependency, dependencyKind);
+}
+
+void corto_depresolver_dependBatch(
+    corto_depresolver this,
+    corto_depresolver_edge *edges,
+    uint32_t count)
+{
+    g_item dependent = NULL;
+    uint32_t i;
+
+    for (i = 0; i < count; i ++) {
+        corto_depresolver_edge *edge = &edges[i];
+
+        /* Batches typically contain the dependencies of a single object */
+        if (!dependent || dependent->o != edge->dependent) {
+            dependent = g_itemLookup(edge->dependent, this);
+        }
+
+        g_depend(this, dependent, edge->kind,
+            g_itemLookup(edge->dependency, this), edge->dependencyKind);
+    }
+}
+
+void corto_depresolver_insert(corto_depresolver this, void *item) {
+    g_itemLookup(item, this);
+}
+
+void corto_depresolver_setActions(
+    corto_depresolver this,
+    corto_depresolver_action onDeclare,
+    corto_depresolver_action onDefine,
+    void *userData)
+{
+    this->onDeclare = onDeclare;
+    this->onDefine = onDefine;
+    this->userData = userData;
+}
+
+void corto_depresolver_stats(
+    corto_depresolver this,
+    corto_depresolver_stats_t *stats)
+{
+    memset(stats, 0, sizeof(corto_depresolver_stats_t));
+    stats->arenaReserved = this->arena.reserved;
+    stats->arenaUsed = this->arena.used;
+    stats->arenaChunks = this->arena.count;
+    stats->indexBytes =
+        this->indexSize * sizeof(g_item) +
+        this->depIndexSize * sizeof(g_dependency);
+    stats->duplicates = this->duplicateCount;
+    stats->items = this->itemCount;
+    stats->declareEdges = this->declareEdges;
+    stats->defineEdges = this->defineEdges;
+    stats->weakEdges = this->weakEdges;
+    stats->brokenEdges = this->brokenCount;
+    stats->reducedEdges = this->reducedCount;
+    stats->sccCount = this->sccCount;
+    stats->sccMaxSize = this->sccMaxSize;
+    stats->sccItems = this->sccItems;
+    stats->buildTime = this->buildTime;
+    stats->freezeTime = this->freezeTime;
+    stats->cycleTime = this->cycleTime;
+    stats->emitTime = this->emitTime;
+    stats->graphBytes =
+        this->countSize * (sizeof(void*) + sizeof(g_itemState)) +
+        (this->countSize ? 2 * this->countSize + 1 : 0) * sizeof(corto_uint32) +
+        this->edgeSize * sizeof(corto_uint32);
+    stats->stackBytes =
+        this->toPrintSize * sizeof(corto_uint32) +
+        this->walkSize * sizeof(corto_uint32) +
+        this->framesSize * sizeof(g_sccFrame) +
+        this->sccStackSize * sizeof(corto_uint32);
+}
+
+/* Get name of item for diagnostics. Returned string must be deallocated. */
+static
+char* g_itemName(
+    corto_depresolver data,
+    corto_uint32 item)
+{
+    char *result = NULL;
+
+    if (data->name) {
+        result = data->name(data->objects[item], data->keyData);
+    }
+    if (!result) {
+        result = ut_asprintf("<%p>", data->objects[item]);
+    }
+
+    return result;
+}
+
+/* Append string to buffer, escaped for JSON strings or, if json is FALSE, for
+ * DOT strings. DOT has no escapes for control characters, so newlines become
+ * line breaks and other control characters are dropped. */
+static
+void g_appendEscaped(
+    ut_strbuf *buf,
+    const char *str,
+    corto_bool json)
+{
+    const char *ptr;
+
+    for (ptr = str; *ptr; ptr ++) {
+        char ch = *ptr;
+        if (ch == '"' || ch == '\\') {
+            ut_strbuf_append(buf, "\\%c", ch);
+        } else if ((unsigned char)ch >= 0x20) {
+            ut_strbuf_append(buf, "%c", ch);
+        } else if (json) {
+            ut_strbuf_append(buf, "\\u%04x", ch);
+        } else if (ch == '\n') {
+            ut_strbuf_appendstr(buf, "\\n");
+        }
+    }
+}
+
+/* Name of state that dependency of edge must reach */
+static
+const char* g_edgeDependencyKind(
+    corto_depresolver data,
+    corto_uint32 item,
+    corto_uint32 e)
+{
+    if (e < data->offsets[2 * item + 1]) {
+        return "DECLARED";
+    } else if (data->edges[e] & G_EDGE_WEAK) {
+        return "DECLARED|VALID";
+    } else {
+        return "VALID";
+    }
+}
+
+char* corto_depresolver_toDot(
+    corto_depresolver this)
+{
+    ut_strbuf buf = UT_STRBUF_INIT;
+    corto_uint32 i, e;
+
+    corto_depresolver_freeze(this);
+
+    ut_strbuf_appendstr(&buf, "digraph depresolver {\n");
+
+    for (i = 0; i < this->count; i ++) {
+        g_itemState *state = &this->state[i];
+        char *name = g_itemName(this, i);
+        ut_strbuf_append(&buf, "    n%u [label=\"", i);
+        g_appendEscaped(&buf, name, FALSE);
+        corto_dealloc(name);
+        ut_strbuf_append(&buf, "\\n%u/%u\"%s];\n",
+            state->declareOrder,
+            state->defineOrder,
+            state->defined ? "" : ", color=red");
+    }
+
+    for (i = 0; i < this->count; i ++) {
+        for (e = this->offsets[2 * i]; e < this->offsets[2 * i + 2]; e ++) {
+            corto_uint32 edge = this->edges[e];
+            ut_strbuf_append(&buf, "    n%u -> n%u [label=\"%s -> %s\"%s%s];\n",
+                i,
+                G_EDGE_ITEM(edge),
+                g_edgeDependencyKind(this, i, e),
+                (edge & G_EDGE_DECLARE) ? "DECLARED" : "VALID",
+                (edge & G_EDGE_WEAK) ? ", style=dashed" : "",
+                (edge & G_EDGE_BROKEN) ? ", color=red" : "");
+        }
+    }
+
+    ut_strbuf_appendstr(&buf, "}\n");
+
+    return ut_strbuf_get(&buf);
+}
+
+char* corto_depresolver_toJson(
+    corto_depresolver this)
+{
+    ut_strbuf buf = UT_STRBUF_INIT;
+    corto_uint32 i, e;
+    corto_bool first = TRUE;
+
+    corto_depresolver_freeze(this);
+
+    ut_strbuf_appendstr(&buf, "{\"items\":[");
+    for (i = 0; i < this->count; i ++) {
+        g_itemState *state = &this->state[i];
+        char *name = g_itemName(this, i);
+        ut_strbuf_append(&buf, "%s{\"id\":%u,\"name\":\"", i ? "," : "", i);
+        g_appendEscaped(&buf, name, TRUE);
+        corto_dealloc(name);
+        ut_strbuf_append(&buf, "\",\"declare\":%u,\"define\":%u}",
+            state->declareOrder,
+            state->defineOrder);
+    }
+
+    ut_strbuf_appendstr(&buf, "],\"edges\":[");
+    for (i = 0; i < this->count; i ++) {
+        for (e = this->offsets[2 * i]; e < this->offsets[2 * i + 2]; e ++) {
+            corto_uint32 edge = this->edges[e];
+            ut_strbuf_append(&buf,
+                "%s{\"dependency\":%u,\"dependencyKind\":\"%s\","
+                "\"dependent\":%u,\"kind\":\"%s\",\"weak\":%s,\"broken\":%s}",
+                first ? "" : ",",
+                i,
+                g_edgeDependencyKind(this, i, e),
+                G_EDGE_ITEM(edge),
+                (edge & G_EDGE_DECLARE) ? "DECLARED" : "VALID",
+                (edge & G_EDGE_WEAK) ? "true" : "false",
+                (edge & G_EDGE_BROKEN) ? "true" : "false");
+            first = FALSE;
+        }
+    }
+    ut_strbuf_appendstr(&buf, "]}\n");
+
+    return ut_strbuf_get(&buf);
+}
+
+char* corto_depresolver_traceStr(
+    corto_depresolver this)
+{
+    ut_strbuf buf = UT_STRBUF_INIT;
+    corto_uint64 i, first = 0;
+
+    if (!this->trace) {
+        return NULL;
+    }
+
+    /* Only the most recent events are kept when the buffer wrapped around */
+    if (this->traceCount > (corto_uint64)this->traceMask + 1) {
+        first = this->traceCount - this->traceMask - 1;
+        ut_strbuf_append(&buf, "(%llu events dropped)\n",
+            (unsigned long long)first);
+    }
+
+    for (i = first; i < this->traceCount; i ++) {
+        g_traceEvent *ev = &this->trace[i & this->traceMask];
+        char *item = g_itemName(this, ev->item), *other = NULL;
+
+        switch (ev->action) {
+        case G_TRACE_DECLARE:
+            ut_strbuf_append(&buf, "declare '%s'\n", item);
+            break;
+        case G_TRACE_DEFINE:
+            ut_strbuf_append(&buf, "define '%s'\n", item);
+            break;
+        case G_TRACE_RESOLVE:
+        case G_TRACE_BREAK:
+            other = g_itemName(this, ev->other);
+            ut_strbuf_append(&buf, "%s: %s '%s' after '%s'\n",
+                ev->action == G_TRACE_RESOLVE ? "resolve" : "break",
+                (ev->edge & G_EDGE_DECLARE) ? "declare" : "define",
+                other,
+                item);
+            break;
+        case G_TRACE_CYCLE:
+            ut_strbuf_append(&buf, "cycle of %u items in component of '%s'\n",
+                ev->other, item);
+            break;
+        case G_TRACE_NO_BREAK:
+            ut_strbuf_append(&buf,
+                "no weak dependency to break in component of '%s'\n", item);
+            break;
+        }
+
+        corto_dealloc(item);
+        if (other) {
+            corto_dealloc(other);
+        }
+    }
+
+    return ut_strbuf_get(&buf);
+}
+
+void corto_depresolver_remove(
+    corto_depresolver this,
+    void *o)
+{
+    corto_uint32 slot = g_indexSlot(this, o, g_itemHash(this, o));
+    g_item item = this->index[slot];
+    g_dependency dep;
+
+    if (!item) {
+        return;
+    }
+
+    /* Remove dependencies of item on other items */
+    for (dep = item->dependsOn; dep; dep = dep->nextDependsOn) {
+        g_dependencyUnlink(dep);
+        g_depIndexRemove(this, dep);
+    }
+
+    /* Remove dependencies of other items on item. These items change. */
+    for (dep = item->onDeclared; dep; dep = dep->next) {
+        g_dependencyUnlinkDependent(dep);
+        g_depIndexRemove(this, dep);
+        g_itemDirty(dep->item, this);
+    }
+    for (dep = item->onDefined; dep; dep = dep->next) {
+        g_dependencyUnlinkDependent(dep);
+        g_depIndexRemove(this, dep);
+        g_itemDirty(dep->item, this);
+    }
+
+    /* Remove item from administration. Memory of the item is released with
+     * the resolver, as it may still be referenced from the dirty list. */
+    g_indexRemove(this, slot);
+    if (item->prev) {
+        item->prev->next = item->next;
+    } else {
+        this->items = item->next;
+    }
+    if (item->next) {
+        item->next->prev = item->prev;
+    }
+    item->removed = TRUE;
+    this->itemCount --;
+    this->frozen = FALSE;
+}
+
+void corto_depresolver_undepend(
+    corto_depresolver this,
+    void* o,
+    corto_state kind,
+    void* d,
+    corto_state dependencyKind)
+{
+    g_item dependent = g_itemFind(o, this);
+    g_item dependency = g_itemFind(d, this);
     g_dependency dep;
-    g_item dependent, dependency;
 
-    ut_debug("depresolver: can't %s '%s' before %s '%s'",
-        corto_ptr_str(&kind, corto_state_o, 0),
-        corto_fullpath(NULL, o),
-        corto_ptr_str(&dependencyKind, corto_state_o, 0),
-        corto_fullpath(NULL, d));
-
-    dependent = g_itemLookup(o, this);
-    dependency = g_itemLookup(d, this);
+    if (!dependent || !dependency) {
+        return;
+    }
 
-    if (dependent->o != dependency->o) {
+    dep = this->depIndex[g_depIndexSlot(this->depIndex, this->depIndexSize,
+        dependent, kind, dependency, dependencyKind)];
+    if (dep) {
+        g_dependencyUnlink(dep);
+        g_dependencyUnlinkDependent(dep);
+        g_depIndexRemove(this, dep);
+        g_itemDirty(dependent, this);
+        this->frozen = FALSE;
+    }
+}
 
-        /* Create dependency object */
-        dep = corto_alloc(sizeof(struct g_dependency));
-        dep->kind = kind;
-        dep->item = dependent;
-        dep->dependency = dependency;
-        dep->weak = FALSE;
-        dep->marked = FALSE;
-        dep->processed = FALSE;
+/* Print the items of the current walk, breaking cycles where needed */
+static
+int g_walkResolve(
+    corto_depresolver this)
+{
+    struct timespec start;
+
+    /* Reset state of previous walk */
+    g_walkReset(this);
+    this->toPrintCount = 0;
+    this->traceCount = 0;
+    this->brokenCount = 0;
+    this->sccCount = 0;
+    this->sccMaxSize = 0;
+    this->sccItems = 0;
+    this->cycleTime = 0;
+    this->emitTime = 0;
+
+    /* Callbacks can only be executed in parallel if they are thread safe.
+     * Threads are kept between walks, so that walking again and updating do
+     * not pay for starting them. */
+    this->parallel =
+        (this->flags & CORTO_DEPRESOLVER_THREADSAFE) && this->workers > 1;
+    if (this->parallel && !this->pool) {
+        this->pool = g_workerPoolNew(this);
+    }
 
-        /* Increase corresponding counter */
-        switch(kind) {
-        case CORTO_DECLARED:
-            dependent->declareCount++;
-            break;
-        case CORTO_VALID:
-            dependent->defineCount++;
-            break;
-        default:
-            ut_assert(0, "invalid dependee-kind.");
+    /* Print initial items */
+    ut_time_get(&start);
+    g_itemCollectInitial(this);
+    if (g_itemPrintItems(this)) {
+        goto error;
+    }
+    this->emitTime += g_elapsed(&start);
+
+    /* Resolve items with cycles, print items after breaking cycles. The
+     * components that are found the first time are the ones that are
+     * reported, as later iterations find what is left of them. */
+    this->sccCounting = TRUE;
+    while (TRUE) {
+        corto_uint32 broken = 0;
+        double emitTime = this->emitTime;
+
+        /* Items that become ready while breaking are printed right away, so
+         * that time is not counted as time spent on cycles */
+        ut_time_get(&start);
+        if (g_itemResolveCycles(this, &broken)) {
+            goto error;
+        }
+        this->sccCounting = FALSE;
+        this->cycleTime += g_elapsed(&start) - (this->emitTime - emitTime);
+        if (!broken) {
             break;
         }
 
-        /* Insert in corresponding list of dependency */
-        switch(dependencyKind) {
-        case CORTO_DECLARED:
-            if (!dependency->onDeclared) {
-                dependency->onDeclared = ut_ll_new();
+        ut_time_get(&start);
+        if (g_itemPrintItems(this)) {
+            goto error;
+        }
+        this->emitTime += g_elapsed(&start);
+    }
+
+    this->parallel = FALSE;
+    return 0;
+error:
+    this->parallel = FALSE;
+    return -1;
+}
+
+/* Count weak dependencies of which the dependent is defined before the
+ * dependency. Each of these requires a forward declaration. A broken
+ * dependency does not always require one, as the dependency may still be
+ * defined first. */
+static
+corto_uint32 g_walkForwardCount(
+    corto_depresolver this)
+{
+    corto_uint32 i, e, result = 0;
+
+    for (i = 0; i < this->walkCount; i ++) {
+        corto_uint32 item = this->walkItems[i];
+        g_itemState *state = &this->state[item];
+        corto_uint32 end = this->offsets[2 * item + 2];
+
+        for (e = this->offsets[2 * item + 1]; e < end; e ++) {
+            corto_uint32 edge = this->edges[e];
+            g_itemState *dependent = &this->state[G_EDGE_ITEM(edge)];
+            if ((edge & G_EDGE_WEAK) && dependent->defined &&
+                (!state->defined || state->defineOrder > dependent->defineOrder))
+            {
+                result ++;
             }
-            ut_ll_insert(dependency->onDeclared, dep);
-            break;
-        case CORTO_DECLARED | CORTO_VALID:
-            dep->weak = TRUE;
-            /* no break */
-        case CORTO_VALID:
-            if (!dependency->onDefined) {
-                dependency->onDefined = ut_ll_new();
+        }
+    }
+
+    return result;
+}
+
+/* Start new walk with all items */
+static
+void g_walkAllItems(
+    corto_depresolver this)
+{
+    corto_uint32 i;
+
+    corto_depresolver_freeze(this);
+
+    this->walk ++;
+    this->walkCount = 0;
+    for (i = 0; i < this->count; i ++) {
+        g_walkAdd(i, this);
+    }
+}
+
+/* Print the items of the current walk */
+static
+int g_walkItems(
+    corto_depresolver this)
+{
+    corto_uint32 i, unresolved = 0;
+
+    /* Clear changes, as they are included in this walk */
+    for (i = 0; i < this->dirtyCount; i ++) {
+        this->dirty[i]->dirty = FALSE;
+    }
+    this->dirtyCount = 0;
+    this->walked = FALSE;
+
+    if (g_walkResolve(this)) {
+        goto error;
+    }
+
+    /* Check if there are still undeclared or undefined objects. */
+    for (i = 0; i < this->walkCount; i ++) {
+        corto_uint32 item = this->walkItems[i];
+        g_itemState *state = &this->state[item];
+        if (!state->defined) {
+            char *name = g_itemName(this, item);
+            if (!state->declared) {
+                ut_warning("not declared/defined: '%s'", name);
+                unresolved++;
+            } else if (!state->defined){
+                ut_warning("not defined: '%s'", name);
+                unresolved++;
             }
-            ut_ll_insert(dependency->onDefined, dep);
-            break;
-        default:
-            ut_assert(0, "invalid dependency-kind (%d)", dependencyKind);
-            break;
+            corto_dealloc(name);
+        }
+    }
+
+    if (unresolved) {
+        if (this->trace) {
+            char *trace = corto_depresolver_traceStr(this);
+            ut_warning("depresolver: trace of failed walk:\n%s", trace);
+            corto_dealloc(trace);
         }
+        ut_throw("unsolvable dependecy cycles encountered in data");
+        goto error;
     }
+
+    this->walked = TRUE;
+
+    return 0;
+error:
+    return -1;
 }
 
-void corto_depresolver_insert(corto_depresolver this, void *item) {
-    g_itemLookup(item, this);
+void corto_depresolver_freeze(corto_depresolver this) {
+    if (!this->frozen) {
+        struct timespec start;
+        ut_time_get(&start);
+        g_freeze(this);
+        this->freezeTime += g_elapsed(&start);
+    }
 }
 
 int corto_depresolver_walk(corto_depresolver this) {
-    ut_iter iter;
-    g_item item;
-    corto_uint32 unresolved = 0;
+    if (!this->buildTime) {
+        this->buildTime = g_elapsed(&this->created);
+    }
+    g_walkAllItems(this);
+    return g_walkItems(this);
+}
 
-    /* Print initial items */
-    if (g_itemPrintItems(this)) {
-        goto error;
+void corto_depresolver_plan(
+    corto_depresolver this,
+    corto_depresolver_plan_t *plan)
+{
+    corto_depresolver_action onDeclare = this->onDeclare;
+    corto_depresolver_action onDefine = this->onDefine;
+    corto_uint32 flags = this->flags, i;
+
+    /* Walk without invoking callbacks, first with greedy cycle breaking */
+    this->onDeclare = NULL;
+    this->onDefine = NULL;
+    this->flags = flags & ~(CORTO_DEPRESOLVER_THREADSAFE | CORTO_DEPRESOLVER_MINIMAL_BREAK);
+    g_walkAllItems(this);
+    g_walkResolve(this);
+    plan->greedyForwardDeclarations = g_walkForwardCount(this);
+
+    this->flags = flags & ~CORTO_DEPRESOLVER_THREADSAFE;
+    g_walkAllItems(this);
+    g_walkResolve(this);
+    plan->forwardDeclarations = g_walkForwardCount(this);
+
+    plan->unresolved = 0;
+    for (i = 0; i < this->walkCount; i ++) {
+        if (!this->state[this->walkItems[i]].defined) {
+            plan->unresolved ++;
+        }
     }
 
-    /* Resolve items with cycles */
-    iter = ut_ll_iter(this->items);
-    while(ut_iter_hasNext(&iter)) {
-        item = ut_iter_next(&iter);
+    /* An update relies on all items being defined by the previous walk */
+    if (plan->unresolved) {
+        this->walked = FALSE;
+    }
 
-        this->iteration ++;
+    this->onDeclare = onDeclare;
+    this->onDefine = onDefine;
+    this->flags = flags;
+}
 
-        /* Process objects that have not yet been defined or declared */
-        if (!item->defined) {
-            ut_debug("depresolver: item '%s' has cycles (declareCount = %d, defineCount = %d, onDeclare = %d, onDefine = %d)",
-                corto_fullpath(NULL, item->o),
-                item->declareCount,
-                item->defineCount,
-                item->onDeclared ? ut_ll_count(item->onDeclared) : 0,
-                item->onDefined ? ut_ll_count(item->onDefined) : 0);
+/* Relax dependent event of a printed event. Events are the declare
+ * (2 * item) and define (2 * item + 1) of items. */
+static
+void g_analyzeRelax(
+    corto_uint32 to,
+    corto_uint32 toOrder,
+    corto_uint32 order,
+    corto_uint32 level,
+    double finish,
+    corto_uint32 *levels,
+    double *start)
+{
+    /* Dependents that were printed earlier depend through a broken edge */
+    if (toOrder <= order) {
+        return;
+    }
+    if (levels[to] < level) {
+        levels[to] = level;
+    }
+    if (start[to] < finish) {
+        start[to] = finish;
+    }
+}
 
-            /* Locate and resolve cycles */
-            this->sp = 0;
-            if (g_itemResolveCycles(item, this)) {
-                goto error;
+void corto_depresolver_analyze(
+    corto_depresolver this,
+    corto_depresolver_costAction costAction,
+    void *userData,
+    corto_depresolver_analysis_t *analysis)
+{
+    corto_depresolver_action onDeclare = this->onDeclare;
+    corto_depresolver_action onDefine = this->onDefine;
+    corto_uint32 flags = this->flags, base = this->sequence, count, i, e;
+    corto_uint32 *events = NULL, *levels = NULL, widthSize = 0;
+    double *start = NULL;
+
+    memset(analysis, 0, sizeof(corto_depresolver_analysis_t));
+
+    /* Resolve without invoking callbacks, so cycles are broken like in a walk */
+    this->onDeclare = NULL;
+    this->onDefine = NULL;
+    this->flags = flags & ~CORTO_DEPRESOLVER_THREADSAFE;
+    g_walkAllItems(this);
+    g_walkResolve(this);
+    this->onDeclare = onDeclare;
+    this->onDefine = onDefine;
+    this->flags = flags;
+
+    /* Sort printed events by their position in the sequence. Every event only
+     * depends on events that were printed before it. */
+    count = this->sequence - base;
+    if (count) {
+        events = corto_alloc(count * sizeof(corto_uint32));
+        levels = corto_calloc(2 * this->count * sizeof(corto_uint32));
+        start = corto_calloc(2 * this->count * sizeof(double));
+    }
+    for (i = 0; i < this->count; i ++) {
+        g_itemState *state = &this->state[i];
+        if (state->declareOrder > base) {
+            events[state->declareOrder - base - 1] = 2 * i;
+        }
+        if (state->defineOrder > base) {
+            events[state->defineOrder - base - 1] = 2 * i + 1;
+        }
+        if (!state->defined) {
+            analysis->unresolved ++;
+        }
+    }
+
+    /* Compute level and earliest start of events in sequence order */
+    for (i = 0; i < count; i ++) {
+        corto_uint32 ev = events[i], item = ev / 2, order = base + i + 1;
+        corto_bool define = ev & 1;
+        g_itemState *state = &this->state[item];
+        corto_uint32 level = levels[ev] + 1;
+        corto_uint32 end = this->offsets[2 * item + 1 + define];
+        double cost = costAction
+            ? costAction(this->objects[item],
+                define ? CORTO_VALID : CORTO_DECLARED, userData)
+            : 1;
+        double finish = start[ev] + cost;
+
+        if (level > widthSize) {
+            widthSize = widthSize ? widthSize * 2 : G_STACK_MIN_SIZE;
+            analysis->width = corto_realloc(
+                analysis->width, widthSize * sizeof(uint32_t));
+        }
+        if (level > analysis->depth) {
+            analysis->width[level - 1] = 0;
+            analysis->depth = level;
+        }
+        if (++ analysis->width[level - 1] > analysis->maxWidth) {
+            analysis->maxWidth = analysis->width[level - 1];
+        }
+
+        analysis->events ++;
+        analysis->work += cost;
+        if (finish > analysis->criticalPath) {
+            analysis->criticalPath = finish;
+        }
+
+        /* An item is defined after it is declared */
+        if (!define) {
+            g_analyzeRelax(ev + 1, state->defineOrder, order, level, finish,
+                levels, start);
+        }
+
+        for (e = this->offsets[2 * item + define]; e < end; e ++) {
+            corto_uint32 edge = this->edges[e];
+            corto_uint32 dependent = G_EDGE_ITEM(edge);
+            g_itemState *dependentState = &this->state[dependent];
+
+            if (edge & G_EDGE_BROKEN) {
+                continue;
             }
 
-            /* Print items after resolving cycle(s) for item. */
-            if (g_itemPrintItems(this)) {
-                goto error;
+            if (edge & G_EDGE_DECLARE) {
+                g_analyzeRelax(2 * dependent, dependentState->declareOrder,
+                    order, level, finish, levels, start);
+            } else {
+                g_analyzeRelax(2 * dependent + 1, dependentState->defineOrder,
+                    order, level, finish, levels, start);
             }
         }
     }
 
+    if (analysis->criticalPath > 0) {
+        analysis->parallelism = analysis->work / analysis->criticalPath;
+    }
 
-    /* Free items and check if there are still undeclared or undefined objects. */
-    while((item = ut_ll_takeFirst(this->items))) {
-        if (!item->defined) {
-            if (!item->declared) {
-                ut_warning("not declared/defined: '%s'",
-                    corto_fullpath(NULL, item->o));
-                unresolved++;
-            } else if (!item->defined){
-                ut_warning("not defined: '%s'",
-                    corto_fullpath(NULL, item->o));
-                unresolved++;
+    /* An update relies on all items being defined by the previous walk */
+    if (analysis->unresolved) {
+        this->walked = FALSE;
+    }
+
+    if (count) {
+        corto_dealloc(events);
+        corto_dealloc(levels);
+        corto_dealloc(start);
+    }
+}
+
+double corto_depresolver_speedup(
+    corto_depresolver_analysis_t *analysis,
+    uint32_t workers)
+{
+    double time;
+
+    if (!workers || analysis->work <= 0) {
+        return 1;
+    }
+
+    /* Workers cannot finish before the work is divided over all workers, nor
+     * before the most expensive chain of events is finished. */
+    time = analysis->work / workers;
+    if (time < analysis->criticalPath) {
+        time = analysis->criticalPath;
+    }
+
+    return analysis->work / time;
+}
+
+void corto_depresolver_analysis_deinit(
+    corto_depresolver_analysis_t *analysis)
+{
+    if (analysis->width) {
+        corto_dealloc(analysis->width);
+        analysis->width = NULL;
+    }
+}
+
+int corto_depresolver_update(corto_depresolver this) {
+    corto_uint32 i;
+
+    /* Without a complete previous walk, there is nothing to update */
+    if (!this->walked) {
+        return corto_depresolver_walk(this);
+    }
+
+    /* Freezing a changed graph does not invoke callbacks, and only costs a
+     * fraction of printing the entire graph. */
+    corto_depresolver_freeze(this);
+
+    /* Collect changed items and everything that (transitively) depends on
+     * them. Other items keep the state of the previous walk. */
+    this->walk ++;
+    this->walkCount = 0;
+    for (i = 0; i < this->dirtyCount; i ++) {
+        g_item item = this->dirty[i];
+        if (!item->removed && this->state[item->index].walk != this->walk) {
+            g_walkAdd(item->index, this);
+        }
+    }
+
+    for (i = 0; i < this->walkCount; i ++) {
+        corto_uint32 item = this->walkItems[i], e;
+        corto_uint32 end = this->offsets[2 * item + 2];
+
+        for (e = this->offsets[2 * item]; e < end; e ++) {
+            corto_uint32 dependent = G_EDGE_ITEM(this->edges[e]);
+            if (this->state[dependent].walk != this->walk) {
+                g_walkAdd(dependent, this);
             }
         }
-        g_itemFree(item);
     }
 
-    /* Free lists */
-    ut_ll_free(this->toPrint);
-    ut_ll_free(this->items);
+    return g_walkItems(this);
+}
 
-    /* Free this */
-    corto_dealloc(this);
+/* Read file in memory. Files are mapped where possible, so that only the
+ * pages that are accessed are read. Returns 1 if the file does not exist. */
+static
+int g_fileMapOpen(
+    const char *file,
+    g_fileMap *map)
+{
+#ifndef _WIN32
+    struct stat st;
+    int fd = open(file, O_RDONLY);
 
-    if (unresolved) {
-        ut_throw("unsolvable dependecy cycles encountered in data");
+    if (fd == -1) {
+        if (errno == ENOENT) {
+            return 1;
+        }
+        ut_throw("failed to open '%s': %s", file, strerror(errno));
+        goto error;
+    }
+
+    if (fstat(fd, &st)) {
+        ut_throw("failed to stat '%s': %s", file, strerror(errno));
+        close(fd);
+        goto error;
+    }
+
+    map->size = st.st_size;
+    map->ptr = NULL;
+    if (map->size) {
+        map->ptr = mmap(NULL, map->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map->ptr == MAP_FAILED) {
+            ut_throw("failed to map '%s': %s", file, strerror(errno));
+            close(fd);
+            goto error;
+        }
+    }
+    close(fd);
+#else
+    FILE *f = fopen(file, "rb");
+    long size;
+
+    if (!f) {
+        if (errno == ENOENT) {
+            return 1;
+        }
+        ut_throw("failed to open '%s': %s", file, strerror(errno));
+        goto error;
+    }
+
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    map->size = size > 0 ? size : 0;
+    map->ptr = corto_alloc(map->size ? map->size : 1);
+    if (fread(map->ptr, 1, map->size, f) != map->size) {
+        ut_throw("failed to read '%s'", file);
+        corto_dealloc(map->ptr);
+        fclose(f);
+        goto error;
+    }
+    fclose(f);
+#endif
+
+    return 0;
+error:
+    return -1;
+}
+
+/* Release file opened with g_fileMapOpen */
+static
+void g_fileMapClose(
+    g_fileMap *map)
+{
+#ifndef _WIN32
+    if (map->ptr) {
+        munmap(map->ptr, map->size);
+    }
+#else
+    corto_dealloc(map->ptr);
+#endif
+}
+
+int corto_depresolver_save(
+    corto_depresolver this,
+    const char *file,
+    uint64_t key,
+    corto_depresolver_nameAction nameAction,
+    void *userData)
+{
+    g_fileHeader header;
+    corto_uint32 *names = NULL, *edges = NULL, i;
+    char *strings = NULL, *tmp = NULL;
+    corto_uint32 stringsLength = 0, stringsSize = 0;
+    FILE *f = NULL;
+
+    corto_depresolver_freeze(this);
+
+    /* Collect names of items in a single string table */
+    names = corto_alloc((this->count ? this->count : 1) * sizeof(corto_uint32));
+    for (i = 0; i < this->count; i ++) {
+        char *name = nameAction(this->objects[i], userData);
+        corto_uint32 length;
+
+        if (!name) {
+            ut_throw("no name for item %u", i);
+            goto error;
+        }
+
+        length = strlen(name) + 1;
+        if (stringsLength + length > stringsSize) {
+            while (stringsLength + length > stringsSize) {
+                stringsSize = stringsSize ? stringsSize * 2 : 1024;
+            }
+            strings = corto_realloc(strings, stringsSize);
+        }
+        memcpy(&strings[stringsLength], name, length);
+        names[i] = stringsLength;
+        stringsLength += length;
+        corto_dealloc(name);
+    }
+
+    /* Only store flags that describe the dependency, not the state of a walk */
+    edges = corto_alloc((this->edgeCount ? this->edgeCount : 1) * sizeof(corto_uint32));
+    for (i = 0; i < this->edgeCount; i ++) {
+        edges[i] = this->edges[i] & ~(G_EDGE_PROCESSED | G_EDGE_BROKEN);
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, G_FILE_MAGIC, sizeof(header.magic));
+    header.version = G_FILE_VERSION;
+    header.key = key;
+    header.count = this->count;
+    header.edgeCount = this->edgeCount;
+    header.stringsLength = stringsLength;
+
+    /* Write to temporary file, so that an interrupted write does not leave a
+     * partial file that could be loaded */
+    tmp = ut_asprintf("%s.tmp", file);
+    if (!(f = fopen(tmp, "wb"))) {
+        ut_throw("failed to open '%s': %s", tmp, strerror(errno));
+        goto error;
+    }
+
+    if (fwrite(&header, sizeof(header), 1, f) != 1 ||
+        fwrite(names, sizeof(corto_uint32), this->count, f) != this->count ||
+        fwrite(this->offsets, sizeof(corto_uint32), 2 * this->count + 1, f) !=
+            2 * this->count + 1 ||
+        fwrite(edges, sizeof(corto_uint32), this->edgeCount, f) != this->edgeCount ||
+        fwrite(strings, 1, stringsLength, f) != stringsLength)
+    {
+        ut_throw("failed to write '%s'", tmp);
+        goto error;
+    }
+
+    if (fclose(f)) {
+        f = NULL;
+        ut_throw("failed to write '%s'", tmp);
+        goto error;
+    }
+    f = NULL;
+
+    if (ut_rename(tmp, file)) {
+        goto error;
+    }
+
+    corto_dealloc(tmp);
+    corto_dealloc(names);
+    corto_dealloc(edges);
+    corto_dealloc(strings);
+
+    return 0;
+error:
+    if (f) {
+        fclose(f);
+    }
+    if (tmp) {
+        remove(tmp);
+        corto_dealloc(tmp);
+    }
+    corto_dealloc(names);
+    corto_dealloc(edges);
+    corto_dealloc(strings);
+    return -1;
+}
+
+int corto_depresolver_load(
+    corto_depresolver this,
+    const char *file,
+    uint64_t key,
+    corto_depresolver_lookupAction lookupAction,
+    void *userData)
+{
+    g_fileMap map;
+    g_fileHeader *header;
+    const corto_uint32 *names, *offsets, *edges;
+    const char *strings;
+    g_item *items = NULL;
+    corto_uint32 i, e, count;
+    size_t size;
+    int ret;
+
+    if ((ret = g_fileMapOpen(file, &map))) {
+        return ret;
+    }
+
+    header = map.ptr;
+    if (map.size < sizeof(g_fileHeader) ||
+        memcmp(header->magic, G_FILE_MAGIC, sizeof(header->magic)))
+    {
+        ut_throw("'%s' is not a dependency graph", file);
+        goto error;
+    }
+
+    /* Graph was stored for other data or by another version */
+    if (header->version != G_FILE_VERSION || header->key != key) {
+        g_fileMapClose(&map);
+        return 1;
+    }
+
+    count = header->count;
+    size = sizeof(g_fileHeader) +
+        ((size_t)3 * count + 1 + header->edgeCount) * sizeof(corto_uint32) +
+        header->stringsLength;
+    if (count >= G_EDGE_MAX_ITEMS || map.size != size) {
+        ut_throw("dependency graph '%s' is corrupt", file);
+        goto error;
+    }
+
+    names = (corto_uint32*)(header + 1);
+    offsets = names + count;
+    edges = offsets + 2 * count + 1;
+    strings = (char*)(edges + header->edgeCount);
+
+    /* Validate graph before adding anything to the resolver */
+    if (offsets[0] != 0 || offsets[2 * count] != header->edgeCount ||
+        (header->stringsLength && strings[header->stringsLength - 1]))
+    {
+        ut_throw("dependency graph '%s' is corrupt", file);
         goto error;
     }
+    for (i = 0; i < count; i ++) {
+        if (names[i] >= header->stringsLength ||
+            offsets[2 * i + 1] < offsets[2 * i] ||
+            offsets[2 * i + 2] < offsets[2 * i + 1])
+        {
+            ut_throw("dependency graph '%s' is corrupt", file);
+            goto error;
+        }
+    }
+    for (e = 0; e < header->edgeCount; e ++) {
+        if (G_EDGE_ITEM(edges[e]) >= count) {
+            ut_throw("dependency graph '%s' is corrupt", file);
+            goto error;
+        }
+    }
+
+    /* Items and dependencies are inserted in reverse, as they are prepended
+     * to their lists. This restores the order in which they were stored. */
+    items = corto_alloc((count ? count : 1) * sizeof(g_item));
+    for (i = count; i > 0; i --) {
+        const char *name = &strings[names[i - 1]];
+        void *o = lookupAction(name, userData);
+        if (!o) {
+            ut_throw("cannot find item '%s' of dependency graph '%s'",
+                name, file);
+            goto error;
+        }
+        items[i - 1] = g_itemLookup(o, this);
+    }
+
+    for (i = 0; i < count; i ++) {
+        for (e = offsets[2 * i + 2]; e > offsets[2 * i]; e --) {
+            corto_uint32 edge = edges[e - 1];
+            corto_state dependencyKind = CORTO_DECLARED;
+            if (e > offsets[2 * i + 1]) {
+                dependencyKind = (edge & G_EDGE_WEAK)
+                    ? CORTO_DECLARED | CORTO_VALID
+                    : CORTO_VALID;
+            }
+            g_depend(this,
+                items[G_EDGE_ITEM(edge)],
+                (edge & G_EDGE_DECLARE) ? CORTO_DECLARED : CORTO_VALID,
+                items[i],
+                dependencyKind);
+        }
+    }
+
+    corto_dealloc(items);
+    g_fileMapClose(&map);
 
     return 0;
 error:
+    corto_dealloc(items);
+    g_fileMapClose(&map);
     return -1;
 }
+
+void corto_depresolver_free(corto_depresolver this) {
+    /* Stop workers */
+    if (this->pool) {
+        g_workerPoolFree(this->pool);
+    }
+
+    /* Free items, dependencies and administration */
+    g_arenaFree(&this->arena);
+    corto_dealloc(this->toPrint);
+    corto_dealloc(this->walkItems);
+    corto_dealloc(this->objects);
+    corto_dealloc(this->state);
+    corto_dealloc(this->offsets);
+    corto_dealloc(this->edges);
+    corto_dealloc(this->dirty);
+    corto_dealloc(this->frontier);
+    corto_dealloc(this->index);
+    corto_dealloc(this->depIndex);
+    corto_dealloc(this->mfas.nodes);
+    corto_dealloc(this->mfas.outOffsets);
+    corto_dealloc(this->mfas.inOffsets);
+    corto_dealloc(this->mfas.sources);
+    corto_dealloc(this->mfas.sinks);
+    corto_dealloc(this->mfas.edges);
+    corto_dealloc(this->mfas.out);
+    corto_dealloc(this->mfas.in);
+    corto_dealloc(this->mfas.heap);
+    corto_dealloc(this->order.members);
+    corto_dealloc(this->order.components);
+    corto_dealloc(this->order.from);
+    corto_dealloc(this->order.to);
+    corto_dealloc(this->order.offsets);
+    corto_dealloc(this->order.targets);
+    corto_dealloc(this->order.inCount);
+    corto_dealloc(this->order.weakCount);
+    corto_dealloc(this->order.blocked);
+    corto_dealloc(this->order.position);
+    corto_dealloc(this->order.heap);
+    corto_dealloc(this->order.byPriority);
+    corto_dealloc(this->order.candidates);
+    corto_dealloc(this->order.sorted);
+    corto_dealloc(this->frames);
+    corto_dealloc(this->sccStack);
+    corto_dealloc(this->trace);
+
+    /* Free this */
+    corto_dealloc(this);
+}
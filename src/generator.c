@@ -20,6 +20,113 @@
  */
 
 #include <corto.g>
+#include "hash.h"
+
+#define G_ANONYMOUS_MIN_SIZE (64)
+#define G_ANONYMOUS_NO_ID ((corto_uint32)-1)
+#define G_PARSE_CACHE_MIN_SIZE (256)
+
+/* Interned object, by pointer. Objects are claimed while in the table, so
+ * that their address is not reused by another object. */
+typedef struct g_anonymousObject {
+    corto_object o;
+    corto_uint32 index; /* Index of canonical object */
+} g_anonymousObject;
+
+/* Canonical object */
+typedef struct g_anonymousEntry {
+    corto_object o;
+    corto_uint32 hash; /* Structural hash of type and value */
+    corto_uint32 id; /* Number for identifiers, or G_ANONYMOUS_NO_ID */
+} g_anonymousEntry;
+
+/* Objects are first looked up by pointer, so the value of an object is only
+ * hashed and compared the first time it is interned. */
+struct g_anonymousTable {
+    g_anonymousEntry *entries; /* Canonical objects, in order of interning */
+    corto_uint32 count;
+    corto_uint32 size;
+    corto_uint32 *buckets; /* Index of canonical object + 1, by hash */
+    corto_uint32 bucketsSize; /* Always a power of two */
+    g_anonymousObject *objects; /* Open addressing table of interned objects */
+    corto_uint32 objectCount;
+    corto_uint32 objectsSize; /* Always a power of two */
+    corto_uint32 idCount;
+};
+
+/* Verdict of g_mustParse for an object, while walking a generator object */
+typedef struct g_parseVerdict {
+    corto_object o;
+    g_object *current;
+    bool mustParse;
+} g_parseVerdict;
+
+/* Verdicts only change when generator objects or attributes change, so they
+ * are kept until then. */
+struct g_parseCache {
+    g_parseVerdict *verdicts; /* Open addressing table */
+    corto_uint32 count;
+    corto_uint32 size; /* Always a power of two */
+};
+
+/* Objects in the order in which g_walkAll visits them. The order survives
+ * g_reset, so drivers loaded on the same generator replay it. */
+struct g_walkOrder {
+    corto_object *objects; /* Claimed while in order */
+    corto_uint32 count;
+    corto_uint32 size;
+};
+
+/* Free anonymous table */
+static
+void g_anonymousFree(
+    g_anonymousTable *t)
+{
+    corto_uint32 i;
+
+    for (i = 0; i < t->objectsSize; i ++) {
+        if (t->objects[i].o) {
+            corto_release(t->objects[i].o);
+        }
+    }
+
+    corto_dealloc(t->entries);
+    corto_dealloc(t->buckets);
+    corto_dealloc(t->objects);
+    corto_dealloc(t);
+}
+
+/* Forget verdicts of g_mustParse */
+static
+void g_parseCacheClear(
+    g_generator g)
+{
+    g_parseCache *cache = g->parseCache;
+
+    if (cache && cache->count) {
+        memset(cache->verdicts, 0, cache->size * sizeof(g_parseVerdict));
+        cache->count = 0;
+    }
+}
+
+/* Forget order of g_walkAll */
+void g_walkAllReset(
+    g_generator g)
+{
+    g_walkOrder *order = g->walkOrder;
+
+    if (order) {
+        corto_uint32 i;
+        for (i = 0; i < order->count; i ++) {
+            corto_release(order->objects[i]);
+        }
+        if (order->objects) {
+            corto_dealloc(order->objects);
+        }
+        corto_dealloc(order);
+        g->walkOrder = NULL;
+    }
+}
 
 /* Close file */
 static
@@ -55,6 +162,9 @@ void g_reset(
     /* Set id-generation to default */
     g->idKind = CORTO_GENERATOR_ID_DEFAULT;
 
+    /* Objects may be deleted between runs */
+    g_parseCacheClear(g);
+
     /* Set action-callbacks */
     g->start_action = NULL;
     g->id_action = NULL;
@@ -205,6 +315,9 @@ void g_parse(
         if ((parseSelf || parseScope) && !g->current) {
             g->current = o;
         }
+
+        g_parseCacheClear(g);
+        g_walkAllReset(g);
     }
 }
 
@@ -246,6 +359,14 @@ void g_setAttribute(
         corto_dealloc(attr->value);
     }
     attr->value = ut_strdup(value);
+
+    /* Attributes like "bootstrap" change which objects are parsed */
+    g_parseCacheClear(g);
+
+    /* Dependencies are disregarded when generating for bootstrap */
+    if (!strcmp(key, "bootstrap")) {
+        g_walkAllReset(g);
+    }
 }
 
 /* Get attribute */
@@ -415,9 +536,18 @@ void g_free(
     }
 
     if (g->anonymousObjects) {
-        ut_ll_free(g->anonymousObjects);
+        g_anonymousFree(g->anonymousObjects);
+    }
+
+    if (g->parseCache) {
+        if (g->parseCache->verdicts) {
+            corto_dealloc(g->parseCache->verdicts);
+        }
+        corto_dealloc(g->parseCache);
     }
 
+    g_walkAllReset(g);
+
     if (g->name) {
         corto_dealloc(g->name);
     }
@@ -494,8 +624,9 @@ bool g_isMarked(
      return bootstrap || (marker && !strcmp(corto_idof(marker), "pp_marker"));
 }
 
-bool g_mustParse(
+bool g_mustParseExt(
     g_generator g,
+    g_object *current,
     corto_object o)
 {
     bool result;
@@ -504,7 +635,7 @@ bool g_mustParse(
     if (corto_check_attr(o, CORTO_ATTR_NAMED) && corto_childof(root_o, o)) {
         if (g_isMarked(g, o)) {
             /* Check if the object is in the list of things to parse */
-            result = !g_checkParseWalk(g->current, o);
+            result = !g_checkParseWalk(current, o);
         } else {
             result = false;
         }
@@ -513,6 +644,67 @@ bool g_mustParse(
     return result;
 }
 
+/* Find slot for object and generator object in cache. Returns empty slot if
+ * there is no verdict. */
+static
+corto_uint32 g_parseCacheSlot(
+    g_parseCache *cache,
+    corto_object o,
+    g_object *current)
+{
+    corto_uint32 mask = cache->size - 1;
+    corto_uint32 slot = g_ptrPairHash(o, current) & mask;
+    g_parseVerdict *v;
+
+    while ((v = &cache->verdicts[slot])->o &&
+        (v->o != o || v->current != current))
+    {
+        slot = (slot + 1) & mask;
+    }
+
+    return slot;
+}
+
+/* Hash of verdict in cache, for rehashing */
+static
+corto_uint32 g_parseCacheHash(
+    const void *entry,
+    void *ctx)
+{
+    const g_parseVerdict *v = entry;
+    CORTO_UNUSED(ctx);
+    return g_ptrPairHash(v->o, v->current);
+}
+
+/* Verdicts are cached per object and generator object, as an object can be
+ * parsed for one generator object and not for another. */
+bool g_mustParse(
+    g_generator g,
+    corto_object o)
+{
+    g_parseCache *cache = g->parseCache;
+    corto_uint32 slot;
+    g_parseVerdict *v;
+
+    if (!cache) {
+        cache = g->parseCache = corto_calloc(sizeof(g_parseCache));
+    }
+
+    g_tableGrow(&cache->verdicts, cache->count, &cache->size,
+        sizeof(g_parseVerdict), G_PARSE_CACHE_MIN_SIZE, g_parseCacheHash, NULL);
+
+    slot = g_parseCacheSlot(cache, o, g->current);
+    v = &cache->verdicts[slot];
+    if (!v->o) {
+        v->o = o;
+        v->current = g->current;
+        v->mustParse = g_mustParseExt(g, g->current, o);
+        cache->count ++;
+    }
+
+    return v->mustParse;
+}
+
 int16_t g_import(
     g_generator g,
     corto_object package)
@@ -696,10 +888,129 @@ int g_walkRecursive(
     return g_walk_ext(g, action, userData, TRUE, TRUE);
 }
 
+/* Walk multiple actions in one traversal */
+typedef struct g_walkMulti_t {
+    g_generator g;
+    g_walkAction *actions;
+    void **userData;
+    corto_uint32 count;
+    corto_uint32 active; /* Number of actions that did not stop */
+    corto_bool *stopped;
+
+    /* Objects collected for walking in phases */
+    corto_object *objects;
+    g_object **current;
+    corto_uint32 objectCount;
+    corto_uint32 objectSize;
+} g_walkMulti_t;
+
+/* Run actions that did not stop on object */
+static
+int g_walkMulti_action(
+    corto_object o,
+    void *userData)
+{
+    g_walkMulti_t *data = userData;
+    corto_uint32 i;
+
+    for (i = 0; i < data->count; i ++) {
+        if (!data->stopped[i]) {
+            if (!data->actions[i](o, data->userData[i])) {
+                data->stopped[i] = TRUE;
+                data->active --;
+            }
+        }
+    }
+
+    return data->active != 0;
+}
+
+/* Collect object and generator object it is parsed for */
+static
+int g_walkMulti_collect(
+    corto_object o,
+    void *userData)
+{
+    g_walkMulti_t *data = userData;
+
+    if (data->objectCount == data->objectSize) {
+        data->objectSize = data->objectSize ? data->objectSize * 2 : 256;
+        data->objects = corto_realloc(
+            data->objects, data->objectSize * sizeof(corto_object));
+        data->current = corto_realloc(
+            data->current, data->objectSize * sizeof(g_object*));
+    }
+
+    data->objects[data->objectCount] = o;
+    data->current[data->objectCount] = data->g->current;
+    data->objectCount ++;
+
+    return 1;
+}
+
+int g_walkMulti(
+    g_generator g,
+    g_walkAction *actions,
+    void **userData,
+    corto_uint32 count,
+    corto_uint32 flags)
+{
+    g_walkMulti_t walkData;
+    bool scopeWalk = !(flags & G_WALK_NOSCOPE);
+    bool recursiveWalk = (flags & G_WALK_RECURSIVE) != 0;
+    corto_uint32 i, j;
+
+    memset(&walkData, 0, sizeof(walkData));
+    walkData.g = g;
+    walkData.actions = actions;
+    walkData.userData = userData;
+    walkData.count = count;
+    walkData.active = count;
+    walkData.stopped = corto_calloc(count * sizeof(corto_bool));
+
+    if (!count) {
+        /* Nothing to walk */
+    } else if (!(flags & G_WALK_PHASES)) {
+        g_walk_ext(
+            g, g_walkMulti_action, &walkData, scopeWalk, recursiveWalk);
+    } else {
+        g_object *current = g->current;
+        bool inWalk = g->inWalk;
+
+        /* Objects are found once, after which actions walk the collected
+         * objects one after another. Actions run in a walk, so that nested
+         * walks start from the generator object of the object. */
+        g_walk_ext(g, g_walkMulti_collect, &walkData, scopeWalk, recursiveWalk);
+        g->inWalk = TRUE;
+        for (i = 0; i < count; i ++) {
+            for (j = 0; j < walkData.objectCount; j ++) {
+                g->current = walkData.current[j];
+                if (!actions[i](walkData.objects[j], userData[i])) {
+                    walkData.stopped[i] = TRUE;
+                    walkData.active --;
+                    break;
+                }
+            }
+        }
+        g->current = current;
+        g->inWalk = inWalk;
+
+        if (walkData.objects) {
+            corto_dealloc(walkData.objects);
+            corto_dealloc(walkData.current);
+        }
+    }
+
+    corto_dealloc(walkData.stopped);
+
+    return walkData.active == count;
+}
+
 /* Walk all objects, including anonymous objects */
 typedef struct g_walkAll_t {
     g_walkAction action;
     void *userData;
+    g_walkOrder *order; /* Order that is recorded */
 } g_walkAll_t;
 
 static
@@ -711,17 +1022,65 @@ int g_walkAll_action(
     return data->action(o, data->userData);
 }
 
+/* Append object to order of g_walkAll */
+static
+int g_walkAll_record(
+    corto_object o,
+    void *userData)
+{
+    g_walkAll_t *data = userData;
+    g_walkOrder *order = data->order;
+
+    if (order->count == order->size) {
+        order->size = order->size ? order->size * 2 : 256;
+        order->objects = corto_realloc(
+            order->objects, order->size * sizeof(corto_object));
+    }
+
+    corto_claim(o);
+    order->objects[order->count ++] = o;
+
+    return data->action(o, data->userData);
+}
+
+/* The dependency order is computed once and replayed by later walks, until
+ * objects to parse or the "bootstrap" attribute change. */
 int g_walkAll(
     g_generator generator,
     g_walkAction action,
     void* userData)
 {
-    g_walkAll_t walkData = {action, userData};
-    return !corto_genDepWalk(
-        generator,
-        NULL,
-        g_walkAll_action,
-        &walkData);
+    g_walkAll_t walkData = {action, userData, NULL};
+    g_walkOrder *order = generator->walkOrder;
+    corto_uint32 i;
+
+    /* A walk inside another walk only walks the current object */
+    if (generator->inWalk) {
+        return !corto_genDepWalk(
+            generator,
+            NULL,
+            g_walkAll_action,
+            &walkData);
+    }
+
+    if (!order) {
+        order = corto_calloc(sizeof(g_walkOrder));
+        walkData.order = order;
+        if (corto_genDepWalk(generator, NULL, g_walkAll_record, &walkData)) {
+            /* Order is incomplete, compute it again on the next walk */
+            generator->walkOrder = order;
+            g_walkAllReset(generator);
+            return 0;
+        }
+        generator->walkOrder = order;
+        return 1;
+    }
+
+    for (i = 0; i < order->count; i ++) {
+        action(order->objects[i], userData);
+    }
+
+    return 1;
 }
 
 /* Instead of looking at overload attribute, check if there are functions
@@ -843,6 +1202,174 @@ error:
     return NULL;
 }
 
+/* Hash type and value of object. Objects that compare equal serialize to the
+ * same string, and so get the same hash. */
+static
+corto_uint32 g_anonymousHash(
+    corto_object o)
+{
+    corto_uint64 h = 0xcbf29ce484222325ULL;
+    corto_uint64 type = (corto_uint64)(uintptr_t)corto_typeof(o);
+    char *value = corto_str(o, 0), *ptr;
+    corto_uint32 i;
+
+    for (i = 0; i < sizeof(type); i ++) {
+        h ^= (type >> (i * 8)) & 0xff;
+        h *= 0x100000001b3ULL;
+    }
+
+    if (value) {
+        for (ptr = value; *ptr; ptr ++) {
+            h ^= (unsigned char)*ptr;
+            h *= 0x100000001b3ULL;
+        }
+        corto_dealloc(value);
+    }
+
+    return (corto_uint32)(h ^ (h >> 32));
+}
+
+/* Find slot for object in pointer table. Returns empty slot if not found. */
+static
+corto_uint32 g_anonymousObjectSlot(
+    g_anonymousTable *t,
+    corto_object o)
+{
+    corto_uint32 mask = t->objectsSize - 1;
+    corto_uint32 slot = g_ptrHash(o) & mask;
+
+    while (t->objects[slot].o && t->objects[slot].o != o) {
+        slot = (slot + 1) & mask;
+    }
+
+    return slot;
+}
+
+/* Find bucket for object with hash. Returns empty bucket if no canonical
+ * object has the same type and value. */
+static
+corto_uint32 g_anonymousBucket(
+    g_anonymousTable *t,
+    corto_object o,
+    corto_uint32 hash)
+{
+    corto_uint32 mask = t->bucketsSize - 1;
+    corto_uint32 bucket = hash & mask, i;
+
+    while ((i = t->buckets[bucket])) {
+        g_anonymousEntry *entry = &t->entries[i - 1];
+        if (entry->hash == hash &&
+            corto_typeof(entry->o) == corto_typeof(o) &&
+            (entry->o == o || corto_compare(entry->o, o) == CORTO_EQ))
+        {
+            break;
+        }
+        bucket = (bucket + 1) & mask;
+    }
+
+    return bucket;
+}
+
+/* Hash of interned object, for rehashing */
+static
+corto_uint32 g_anonymousObjectHash(
+    const void *entry,
+    void *ctx)
+{
+    CORTO_UNUSED(ctx);
+    return g_ptrHash(((const g_anonymousObject*)entry)->o);
+}
+
+/* Hash of bucket, for rehashing */
+static
+corto_uint32 g_anonymousBucketHash(
+    const void *entry,
+    void *ctx)
+{
+    g_anonymousTable *t = ctx;
+    return t->entries[*(const corto_uint32*)entry - 1].hash;
+}
+
+/* Grow tables when they are more than 70% full */
+static
+void g_anonymousGrow(
+    g_anonymousTable *t)
+{
+    g_tableGrow(&t->objects, t->objectCount, &t->objectsSize,
+        sizeof(g_anonymousObject), G_ANONYMOUS_MIN_SIZE,
+        g_anonymousObjectHash, NULL);
+
+    g_tableGrow(&t->buckets, t->count, &t->bucketsSize,
+        sizeof(corto_uint32), G_ANONYMOUS_MIN_SIZE,
+        g_anonymousBucketHash, t);
+
+    if (t->count == t->size) {
+        t->size = t->size ? t->size * 2 : G_ANONYMOUS_MIN_SIZE;
+        t->entries = corto_realloc(
+            t->entries, t->size * sizeof(g_anonymousEntry));
+    }
+}
+
+corto_object g_anonymousIntern(
+    g_generator g,
+    corto_object o,
+    corto_uint32 *index)
+{
+    g_anonymousTable *t = g->anonymousObjects;
+    corto_uint32 slot, i;
+
+    if (!t) {
+        t = g->anonymousObjects = corto_calloc(sizeof(g_anonymousTable));
+    }
+
+    g_anonymousGrow(t);
+
+    slot = g_anonymousObjectSlot(t, o);
+    if (t->objects[slot].o) {
+        i = t->objects[slot].index;
+    } else {
+        corto_uint32 hash = g_anonymousHash(o);
+        corto_uint32 bucket = g_anonymousBucket(t, o, hash);
+
+        if (t->buckets[bucket]) {
+            i = t->buckets[bucket] - 1;
+        } else {
+            i = t->count ++;
+            t->entries[i].o = o;
+            t->entries[i].hash = hash;
+            t->entries[i].id = G_ANONYMOUS_NO_ID;
+            t->buckets[bucket] = i + 1;
+        }
+
+        corto_claim(o);
+        t->objects[slot].o = o;
+        t->objects[slot].index = i;
+        t->objectCount ++;
+    }
+
+    if (index) {
+        *index = i;
+    }
+
+    return t->entries[i].o;
+}
+
+corto_uint32 g_anonymousId(
+    g_generator g,
+    corto_object o)
+{
+    corto_uint32 i;
+    g_anonymousEntry *entry;
+
+    g_anonymousIntern(g, o, &i);
+    entry = &g->anonymousObjects->entries[i];
+    if (entry->id == G_ANONYMOUS_NO_ID) {
+        entry->id = g->anonymousObjects->idCount ++;
+    }
+
+    return entry->id;
+}
+
 /* Translate object-id */
 char* g_fullOidExt(
     g_generator g,
@@ -883,24 +1410,7 @@ char* g_fullOidExt(
         }
         g_oidTransform(g, o, _id, kind);
     } else {
-        uint32_t count = 0;
-
-        if (!g->anonymousObjects) {
-            g->anonymousObjects = ut_ll_new();
-        }
-        ut_iter it = ut_ll_iter(g->anonymousObjects);
-        while (ut_iter_hasNext(&it)) {
-            corto_object e = ut_iter_next(&it);
-            if (e == o) {
-                break;
-            } else if (corto_compare(e, o) == CORTO_EQ) {
-                break;
-            }
-            count ++;
-        }
-        if (count == ut_ll_count(g->anonymousObjects)) {
-            ut_ll_append(g->anonymousObjects, o);
-        }
+        uint32_t count = g_anonymousId(g, o);
 
         corto_object cur = g_getCurrent(g);
         if (corto_instanceof(corto_package_o, cur)) {
@@ -1240,8 +1750,8 @@ char* g_hiddenFilePath(
     vsprintf(namebuffer, name, args);
     va_end(args);
 
-    char *hidden;
-    if (!(hidden = g_getAttribute(g, "hidden"))) {
+    char *hidden = g_getAttribute(g, "hidden");
+    if (!hidden[0]) {
         hidden = ".corto";
     }
 
@@ -1277,8 +1787,8 @@ g_file g_hiddenFileOpen(
     vsprintf(namebuffer, name, args);
     va_end(args);
 
-    char *hidden;
-    if (!(hidden = g_getAttribute(g, "hidden"))) {
+    char *hidden = g_getAttribute(g, "hidden");
+    if (!hidden[0]) {
         hidden = ".corto";
     }
 
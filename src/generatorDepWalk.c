@@ -20,12 +20,84 @@
  */
 
 #include <corto.g>
+#include "hash.h"
 
 static
 int corto_genDepBuildAction(
     corto_object o,
     void* userData);
 
+typedef struct corto_genDepFingerprint_t corto_genDepFingerprint_t;
+
+static
+void corto_genDepFingerprintCheck(
+    corto_genDepFingerprint_t *data,
+    corto_object o);
+
+#define CORTO_GENDEP_COND_MIN_SIZE (16)
+#define CORTO_GENDEP_REFS_MIN_SIZE (64)
+#define CORTO_GENDEP_CHUNK (16) /* Objects a worker takes at a time */
+
+/* Dependency recorded by a worker. Anonymous objects are replaced by their
+ * canonical object when records are added to the resolver, as interning is
+ * not thread safe. */
+typedef struct corto_genDepRecord {
+    corto_object dependent;
+    corto_object dependency; /* NULL if record inserts dependent */
+    corto_uint8 kind;
+    corto_uint8 dependencyKind;
+    corto_bool dependentAnonymous;
+    corto_bool dependencyAnonymous;
+} corto_genDepRecord;
+
+/* Compiled stateCondExpr of a member, for objects of one type. If the field
+ * that the expression refers to is a boolean or integer that is reached only
+ * through members of structs and classes, the field is read directly and is
+ * TRUE when it is not zero. Otherwise the expression is resolved for every
+ * object. */
+typedef struct corto_genDepCond {
+    corto_member member;
+    corto_type type; /* Type of objects the expression is evaluated on */
+    corto_bool direct; /* Field is read at offset */
+    corto_uint32 offset;
+    corto_uint32 size;
+} corto_genDepCond;
+
+/* Kinds of locations in a value that can hold references */
+typedef enum corto_genDepRefKind {
+    CORTO_GENDEP_REF_MEMBER, /* Reference member */
+    CORTO_GENDEP_REF_ARRAY, /* Array stored in value */
+    CORTO_GENDEP_REF_SEQUENCE /* Sequence, elements are stored in buffer */
+} corto_genDepRefKind;
+
+/* Location of references in a value */
+typedef struct corto_genDepRef {
+    corto_genDepRefKind kind;
+    corto_uint32 offset;
+    corto_member member; /* Member that holds reference */
+    corto_uint32 count; /* Number of elements in array */
+    corto_uint32 stride; /* Size of element */
+    struct corto_genDepRefs *element; /* NULL if element is a reference */
+} corto_genDepRef;
+
+/* References in values of a type, in the order in which corto_walk visits
+ * them. Types with values that cannot be described by a table (unions, lists,
+ * maps, any, optional members) are walked with corto_walk. */
+typedef struct corto_genDepRefs {
+    corto_type type;
+    corto_bool walk; /* Walk values with corto_walk */
+    corto_bool done; /* Table is complete */
+    corto_genDepRef *refs; /* If empty, values have no references */
+    corto_uint32 count;
+    corto_uint32 size;
+} corto_genDepRefs;
+
+/* Layout of sequences */
+typedef struct corto_genDepSeq {
+    corto_uint32 length;
+    void *buffer;
+} corto_genDepSeq;
+
 /* Walk objects in correct dependency order. */
 typedef struct g_itemWalk_t *g_itemWalk_t;
 struct g_itemWalk_t {
@@ -35,16 +107,142 @@ struct g_itemWalk_t {
     corto_bool bootstrap;
     corto_depresolver_action onDeclare;
     corto_depresolver_action onDefine;
-    ut_ll anonymousObjects;
+    corto_depresolver_edge *edges; /* Dependencies not yet added to resolver */
+    corto_uint32 edgeCount;
+    corto_uint32 edgeSize;
+    corto_genDepCond *conds; /* Open addressing table of compiled expressions */
+    corto_uint32 condCount;
+    corto_uint32 condSize; /* Always a power of two */
+    corto_genDepRefs **types; /* Open addressing table of reference tables */
+    corto_uint32 typeCount;
+    corto_uint32 typeSize; /* Always a power of two */
+    corto_bool walkValues; /* Walk all values with corto_walk */
+    corto_genDepFingerprint_t *fingerprint; /* Fingerprint of cached graph */
+
+    /* Workers do not have a resolver. They record dependencies of objects
+     * that are parsed for the current generator object. */
+    g_object *current;
+    corto_genDepRecord *records;
+    corto_uint32 recordCount;
+    corto_uint32 recordSize;
 };
 
 typedef struct g_depWalk_t* g_depWalk_t;
 struct g_depWalk_t  {
     corto_object o;
     g_itemWalk_t data;
-    ut_ll anonymousObjects;
 };
 
+/* Test if object is anonymous */
+static
+corto_bool corto_genDepIsAnonymous(
+    corto_object o)
+{
+    return !corto_check_attr(o, CORTO_ATTR_NAMED) || !corto_childof(root_o, o);
+}
+
+/* Record dependency in worker */
+static
+void corto_genDepRecordAdd(
+    g_itemWalk_t data,
+    corto_object o,
+    corto_state kind,
+    corto_object d,
+    corto_state dependencyKind)
+{
+    corto_genDepRecord *record;
+
+    if (data->recordCount == data->recordSize) {
+        data->recordSize = data->recordSize ? data->recordSize * 2 : 256;
+        data->records = corto_realloc(
+            data->records, data->recordSize * sizeof(corto_genDepRecord));
+    }
+
+    record = &data->records[data->recordCount ++];
+    record->dependent = o;
+    record->dependency = d;
+    record->kind = kind;
+    record->dependencyKind = dependencyKind;
+    record->dependentAnonymous = corto_genDepIsAnonymous(o);
+    record->dependencyAnonymous = d ? corto_genDepIsAnonymous(d) : FALSE;
+}
+
+/* Test if object must be parsed */
+static
+bool corto_genDepMustParse(
+    g_itemWalk_t data,
+    corto_object o)
+{
+    if (data->resolver) {
+        return g_mustParse(data->g, o);
+    } else {
+        return g_mustParseExt(data->g, data->current, o);
+    }
+}
+
+/* Buffer dependency. Dependencies of an object are added in one batch. */
+static
+void corto_genDepAdd(
+    g_itemWalk_t data,
+    corto_object o,
+    corto_state kind,
+    corto_object d,
+    corto_state dependencyKind)
+{
+    corto_depresolver_edge *edge;
+
+    if (!data->resolver) {
+        corto_genDepRecordAdd(data, o, kind, d, dependencyKind);
+        return;
+    }
+
+    /* Dependencies can be on types that are not inserted */
+    if (data->fingerprint) {
+        corto_genDepFingerprintCheck(data->fingerprint, d);
+    }
+
+    if (data->edgeCount == data->edgeSize) {
+        data->edgeSize = data->edgeSize ? data->edgeSize * 2 : 32;
+        data->edges = corto_realloc(
+            data->edges, data->edgeSize * sizeof(corto_depresolver_edge));
+    }
+
+    edge = &data->edges[data->edgeCount ++];
+    edge->dependent = o;
+    edge->kind = kind;
+    edge->dependency = d;
+    edge->dependencyKind = dependencyKind;
+}
+
+/* Add buffered dependencies to resolver */
+static
+void corto_genDepFlush(
+    g_itemWalk_t data)
+{
+    if (data->edgeCount) {
+        corto_depresolver_dependBatch(
+            data->resolver, data->edges, data->edgeCount);
+        data->edgeCount = 0;
+    }
+}
+
+/* Add object to resolver, after the dependencies added before it */
+static
+void corto_genDepInsert(
+    g_itemWalk_t data,
+    corto_object o)
+{
+    if (!data->resolver) {
+        corto_genDepRecordAdd(data, o, 0, NULL, 0);
+    } else {
+        corto_genDepFlush(data);
+        corto_depresolver_insert(data->resolver, o);
+        if (data->fingerprint) {
+            corto_genDepFingerprintCheck(data->fingerprint, o);
+        }
+    }
+}
+
 static
 corto_object corto_genDepFindAnonymous(
     g_depWalk_t data,
@@ -52,52 +250,219 @@ corto_object corto_genDepFindAnonymous(
 {
     corto_object result = o;
 
-    if (!corto_check_attr(o, CORTO_ATTR_NAMED) || !corto_childof(root_o, o)) {
-        if (!data->anonymousObjects) {
-            data->anonymousObjects = ut_ll_new();
+    /* Workers leave interning to the thread that merges their records */
+    if (data->data->resolver && corto_genDepIsAnonymous(o)) {
+        result = g_anonymousIntern(data->data->g, o, NULL);
+    }
+
+    return result;
+}
+
+/* Find slot for member and type in table of compiled expressions */
+static
+corto_uint32 corto_genDepCondSlot(
+    corto_genDepCond *conds,
+    corto_uint32 size,
+    corto_member m,
+    corto_type t)
+{
+    corto_uint32 mask = size - 1;
+    corto_uint32 slot = g_ptrPairHash(m, t) & mask;
+
+    while (conds[slot].member &&
+        (conds[slot].member != m || conds[slot].type != t))
+    {
+        slot = (slot + 1) & mask;
+    }
+
+    return slot;
+}
+
+/* Hash of compiled expression, for rehashing */
+static
+corto_uint32 corto_genDepCondHash(
+    const void *entry,
+    void *ctx)
+{
+    const corto_genDepCond *cond = entry;
+    CORTO_UNUSED(ctx);
+    return g_ptrPairHash(cond->member, cond->type);
+}
+
+/* Find offset and type of field that expression refers to in values of type.
+ * Only expressions that are a path of members of structs and classes have a
+ * fixed location. Members of unions depend on the discriminator, and optional
+ * and observable members are stored elsewhere. Returns FALSE if the field does
+ * not have a fixed location. */
+static
+corto_bool corto_genDepCondPath(
+    corto_type t,
+    const char *expr,
+    corto_uint32 *offset,
+    corto_type *fieldType)
+{
+    const char *ptr = expr;
+
+    *offset = 0;
+    while (TRUE) {
+        corto_id name;
+        corto_uint32 length = 0;
+        corto_member m;
+
+        if (t->kind != CORTO_COMPOSITE ||
+            (corto_interface(t)->kind != CORTO_STRUCT &&
+             corto_interface(t)->kind != CORTO_CLASS))
+        {
+            return FALSE;
         }
 
-        ut_iter iter = ut_ll_iter(data->anonymousObjects);
-        while (ut_iter_hasNext(&iter)) {
-            corto_object a = ut_iter_next(&iter);
-            if (corto_compare(o, a) == CORTO_EQ) {
-                result = a;
-                break;
+        while ((*ptr >= 'a' && *ptr <= 'z') || (*ptr >= 'A' && *ptr <= 'Z') ||
+            (*ptr >= '0' && *ptr <= '9') || *ptr == '_')
+        {
+            if (length == sizeof(corto_id) - 1) {
+                return FALSE;
             }
+            name[length ++] = *ptr ++;
+        }
+        name[length] = '\0';
+        if (!length || (*ptr && *ptr != '.')) {
+            return FALSE;
+        }
+
+        m = corto_interface_resolveMember(corto_interface(t), name);
+        if (!m || corto_typeof(m) != corto_type(corto_member_o) ||
+            (m->modifiers & (CORTO_OPTIONAL | CORTO_OBSERVABLE)) ||
+            m->type->reference)
+        {
+            return FALSE;
         }
 
-        if (o == result) {
-            ut_ll_append(data->anonymousObjects, o);
+        *offset += m->offset;
+        t = m->type;
+        if (!*ptr) {
+            break;
         }
+        ptr ++;
     }
 
-    return result;
+    *fieldType = t;
+
+    return TRUE;
 }
 
-/* Serialize dependencies on references */
+/* Resolve stateCondExpr of member for objects with the type of o. */
 static
-corto_int16 corto_genDepReference(
-    corto_walk_opt* s,
-    corto_value* info,
-    void* userData)
+corto_genDepCond* corto_genDepCondCompile(
+    g_itemWalk_t data,
+    corto_member m,
+    corto_object o)
 {
-    corto_object o = *(corto_object*)corto_value_ptrof(info);
-    g_depWalk_t data = userData;
+    corto_type t = corto_typeof(o), fieldType;
+    corto_uint32 slot, offset;
+    corto_genDepCond *cond;
 
-    CORTO_UNUSED(s);
+    if (data->condSize) {
+        slot = corto_genDepCondSlot(data->conds, data->condSize, m, t);
+        if (data->conds[slot].member) {
+            return &data->conds[slot];
+        }
+    }
 
-    if (o && g_mustParse(data->data->g, o)) {
-        corto_member m;
+    g_tableGrow(&data->conds, data->condCount, &data->condSize,
+        sizeof(corto_genDepCond), CORTO_GENDEP_COND_MIN_SIZE,
+        corto_genDepCondHash, NULL);
+
+    slot = corto_genDepCondSlot(data->conds, data->condSize, m, t);
+    cond = &data->conds[slot];
+    cond->member = m;
+    cond->type = t;
+    cond->direct = FALSE;
+    cond->offset = 0;
+    cond->size = 0;
+    data->condCount ++;
+
+    /* Fields that are read directly must have the same location in every
+     * object of the type */
+    if (!corto_genDepCondPath(t, m->stateCondExpr, &offset, &fieldType)) {
+        return cond;
+    }
+
+    if (fieldType->kind == CORTO_PRIMITIVE) {
+        switch(corto_primitive(fieldType)->kind) {
+        case CORTO_BOOLEAN:
+        case CORTO_INTEGER:
+        case CORTO_UINTEGER:
+            cond->direct = TRUE;
+            cond->offset = offset;
+            cond->size = corto_type_sizeof(fieldType);
+            break;
+        default:
+            break;
+        }
+    }
+
+    return cond;
+}
+
+/* Evaluate stateCondExpr of member for object */
+static
+int corto_genDepCondEval(
+    g_itemWalk_t data,
+    corto_member m,
+    corto_object o,
+    corto_bool *result)
+{
+    corto_genDepCond *cond = corto_genDepCondCompile(data, m, o);
+
+    if (cond->direct) {
+        char *ptr = (char*)o + cond->offset;
+        corto_uint32 i;
+
+        *result = FALSE;
+        for (i = 0; i < cond->size; i ++) {
+            if (ptr[i]) {
+                *result = TRUE;
+                break;
+            }
+        }
+    } else {
+        corto_value v = corto_value_object(o, NULL);
+        corto_value out;
 
-        m = NULL;
+        if (corto_value_field(&v, m->stateCondExpr, &out)) {
+            ut_throw("invalid stateCondExpr '%s' for member '%s'",
+                m->stateCondExpr,
+                corto_fullpath(NULL, m));
+            goto error;
+        }
 
-        if (info->kind == CORTO_MEMBER) {
-            m = info->is.member.member;
-            if (!m->type->reference) {
-                m = NULL;
+        if (corto_value_typeof(&out) != corto_type(corto_bool_o)) {
+            if (corto_value_cast(&out, corto_bool_o, &out)) {
+                ut_throw(
+            "stateCondExpr '%s' of member '%s' is not castable to a boolean",
+                    m->stateCondExpr,
+                    corto_fullpath(NULL, m));
+                goto error;
             }
         }
 
+        *result = *(corto_bool*)corto_value_ptrof(&out);
+    }
+
+    return 0;
+error:
+    return -1;
+}
+
+/* Add dependency on reference. Member is NULL if the reference is not stored
+ * in a reference member. */
+static
+corto_int16 corto_genDepReferenceExt(
+    g_depWalk_t data,
+    corto_object o,
+    corto_member m)
+{
+    if (o && corto_genDepMustParse(data->data, o)) {
         /* Include dependencies on anonymous types */
         if (!corto_check_attr(o, CORTO_ATTR_NAMED) ||
             !corto_childof(root_o, o))
@@ -109,6 +474,9 @@ corto_int16 corto_genDepReference(
              */
 
             o = corto_genDepFindAnonymous(data, o);
+
+            /* Preserve the order in which dependencies are added */
+            corto_genDepFlush(data->data);
             corto_genDepBuildAction(o, data->data);
         }
 
@@ -117,29 +485,13 @@ corto_int16 corto_genDepReference(
             corto_state state = m->state;
 
             if (m->stateCondExpr) {
-                corto_value v = corto_value_object(o, NULL);
-                corto_value out;
+                corto_bool result;
 
-                if (corto_value_field(&v, m->stateCondExpr, &out)) {
-                    ut_throw("invalid stateCondExpr '%s' for member '%s'",
-                        m->stateCondExpr,
-                        corto_fullpath(NULL, m));
+                if (corto_genDepCondEval(data->data, m, o, &result)) {
                     goto error;
                 }
 
-                if (corto_value_typeof(&out) != corto_type(corto_bool_o)) {
-                    if (corto_value_cast(&out, corto_bool_o, &out)) {
-                        ut_throw(
-            "stateCondExpr '%s' of member '%s' is not castable to a boolean",
-                            m->stateCondExpr,
-                            corto_fullpath(NULL, m));
-                        goto error;
-                    }
-                }
-
-                corto_bool *result = corto_value_ptrof(&out);
-
-                if (!*result) {
+                if (!result) {
                     switch(state) {
                     case CORTO_DECLARED | CORTO_VALID:
                         state = CORTO_VALID;
@@ -154,11 +506,9 @@ corto_int16 corto_genDepReference(
                 }
             }
 
-            corto_depresolver_depend(
-                data->data->resolver, data->o, CORTO_VALID, o, state);
+            corto_genDepAdd(data->data, data->o, CORTO_VALID, o, state);
         } else {
-            corto_depresolver_depend(
-                data->data->resolver, data->o, CORTO_VALID, o, CORTO_VALID);
+            corto_genDepAdd(data->data, data->o, CORTO_VALID, o, CORTO_VALID);
         }
     }
 
@@ -167,6 +517,28 @@ error:
     return -1;
 }
 
+/* Serialize dependencies on references */
+static
+corto_int16 corto_genDepReference(
+    corto_walk_opt* s,
+    corto_value* info,
+    void* userData)
+{
+    corto_object o = *(corto_object*)corto_value_ptrof(info);
+    corto_member m = NULL;
+
+    CORTO_UNUSED(s);
+
+    if (info->kind == CORTO_MEMBER) {
+        m = info->is.member.member;
+        if (!m->type->reference) {
+            m = NULL;
+        }
+    }
+
+    return corto_genDepReferenceExt(userData, o, m);
+}
+
 /* Dependency serializer */
 corto_walk_opt corto_genDepSerializer(void) {
     corto_walk_opt s;
@@ -180,138 +552,445 @@ corto_walk_opt corto_genDepSerializer(void) {
     return s;
 }
 
-/* Add dependencies for function arguments */
+/* Find slot for type in table of reference tables */
 static
-int corto_genDepBuildProc(
-    corto_function f,
-    struct g_depWalk_t* data)
+corto_uint32 corto_genDepRefsSlot(
+    corto_genDepRefs **types,
+    corto_uint32 size,
+    corto_type t)
 {
-    corto_uint32 i;
-    corto_type t;
-
-    for(i=0; i<f->parameters.length; i++) {
-        t = f->parameters.buffer[i].type;
-        if (g_mustParse(data->data->g, t)) {
-            t = corto_genDepFindAnonymous(data, t);
+    corto_uint32 mask = size - 1;
+    corto_uint32 slot = g_ptrHash(t) & mask;
 
-            /* Type must be at least declared when the function is declared. */
-            corto_depresolver_depend(
-                data->data->resolver,
-                f,
-                CORTO_DECLARED,
-                t,
-                CORTO_DECLARED | CORTO_VALID);
-        }
+    while (types[slot] && types[slot]->type != t) {
+        slot = (slot + 1) & mask;
     }
 
-    return 0;
+    return slot;
 }
 
-/* Build dependency-administration for object */
+/* Hash of reference table, for rehashing */
 static
-int corto_genDepBuildAction(
-    corto_object o,
-    void* userData)
+corto_uint32 corto_genDepRefsHash(
+    const void *entry,
+    void *ctx)
 {
-    g_itemWalk_t data;
-    struct g_depWalk_t walkData;
-    corto_walk_opt s;
-    corto_object parent = NULL;
+    CORTO_UNUSED(ctx);
+    return g_ptrHash((*(corto_genDepRefs* const*)entry)->type);
+}
 
-    if (corto_check_attr(o, CORTO_ATTR_NAMED)) {
-        parent = corto_parentof(o);
+/* Append location to reference table */
+static
+corto_genDepRef* corto_genDepRefsAppend(
+    corto_genDepRefs *refs,
+    corto_genDepRefKind kind,
+    corto_uint32 offset)
+{
+    corto_genDepRef *ref;
+
+    if (refs->count == refs->size) {
+        refs->size = refs->size ? refs->size * 2 : 4;
+        refs->refs = corto_realloc(
+            refs->refs, refs->size * sizeof(corto_genDepRef));
     }
 
-    data = userData;
+    ref = &refs->refs[refs->count ++];
+    ref->kind = kind;
+    ref->offset = offset;
+    ref->member = NULL;
+    ref->count = 0;
+    ref->stride = 0;
+    ref->element = NULL;
 
-    walkData.o = o;
-    walkData.data = data;
-    walkData.anonymousObjects = data->anonymousObjects;
+    return ref;
+}
 
-    /* Object can be declared only after its type is defined. */
-    if (g_mustParse(data->g, corto_typeof(o))) {
-        corto_type t = corto_genDepFindAnonymous(&walkData, corto_typeof(o));
-        corto_depresolver_depend(
-            data->resolver, o, CORTO_DECLARED, t, CORTO_VALID);
-    }
+static
+corto_genDepRefs* corto_genDepRefsGet(
+    g_itemWalk_t data,
+    corto_type t);
 
-    /* TODO: this is not nice */
-    if (corto_class_instanceof(corto_procedure_o, corto_typeof(o))) {
-        /* Insert base-dependency: methods may only be declared after the base
-         * of a class has been defined. */
-        if (corto_typeof(o) != corto_type(corto_function_o)) {
-            if (corto_class_instanceof(corto_class_o, parent) &&
-                corto_interface(parent)->base)
+/* Add locations of references in value of type at offset. Returns -1 if the
+ * value cannot be described by a table. */
+static
+int corto_genDepRefsAddValue(
+    g_itemWalk_t data,
+    corto_genDepRefs *refs,
+    corto_type t,
+    corto_uint32 offset)
+{
+    switch(t->kind) {
+    case CORTO_VOID:
+    case CORTO_PRIMITIVE:
+        break;
+    case CORTO_COMPOSITE: {
+        corto_interface type = corto_interface(t);
+        corto_uint32 i;
+
+        if (type->kind != CORTO_STRUCT && type->kind != CORTO_CLASS) {
+            goto unsupported;
+        }
+
+        /* Members of base are walked first */
+        if (type->base) {
+            if (corto_genDepRefsAddValue(
+                data, refs, corto_type(type->base), offset))
             {
-                if (g_mustParse(data->g, corto_interface(parent)->base)) {
-                    corto_depresolver_depend(
-                        data->resolver,
-                        o,
-                        CORTO_DECLARED,
-                        corto_interface(parent)->base,
-                        CORTO_VALID);
-                }
+                goto unsupported;
             }
         }
 
-        /* Add dependencies on function parameters - types must be declared
-         * before function is declared. */
-        if (corto_genDepBuildProc(corto_function(o), &walkData)) {
-            goto error;
+        for (i = 0; i < type->members.length; i ++) {
+            corto_member m = type->members.buffer[i];
+
+            if (corto_typeof(m) != corto_type(corto_member_o)) {
+                goto unsupported;
+            }
+
+            /* Local members are not walked by the dependency serializer */
+            if (m->modifiers & CORTO_LOCAL) {
+                continue;
+            }
+
+            /* Optional and observable members are stored as pointers */
+            if (m->modifiers & (CORTO_OPTIONAL | CORTO_OBSERVABLE)) {
+                goto unsupported;
+            }
+
+            if (m->type->reference) {
+                corto_genDepRef *ref = corto_genDepRefsAppend(
+                    refs, CORTO_GENDEP_REF_MEMBER, offset + m->offset);
+                ref->member = m;
+            } else if (corto_genDepRefsAddValue(
+                data, refs, m->type, offset + m->offset))
+            {
+                goto unsupported;
+            }
         }
+        break;
     }
+    case CORTO_COLLECTION: {
+        corto_collection type = corto_collection(t);
+        corto_genDepRefs *element = NULL;
+        corto_genDepRef *ref;
+        corto_uint32 stride = sizeof(corto_object);
 
-    /* Insert dependency on parent */
-    if (corto_check_attr(o, CORTO_ATTR_NAMED) && corto_parentof(o)) {
-        if (parent != root_o) { /* Root is always available */
-            corto_int8 parentState =
-                corto_type(corto_typeof(o))->parent_state;
+        if (!type->element_type->reference) {
+            element = corto_genDepRefsGet(data, type->element_type);
+            if (element->walk) {
+                goto unsupported;
+            }
 
-            corto_depresolver_depend(
-                data->resolver, o, CORTO_DECLARED, parent, parentState);
-            if (parentState == CORTO_DECLARED) {
-                corto_depresolver_depend(
-                    data->resolver, parent, CORTO_VALID, o, CORTO_VALID);
+            /* Elements without references are skipped */
+            if (element->done && !element->count) {
+                break;
             }
+
+            stride = corto_type_sizeof(type->element_type);
         }
-    }
 
-    /* Guard to ensure that the object is added to the dependency
-     * administration */
-    corto_depresolver_insert(data->resolver, o);
+        if (type->kind == CORTO_ARRAY) {
+            ref = corto_genDepRefsAppend(refs, CORTO_GENDEP_REF_ARRAY, offset);
+            ref->count = type->max;
+        } else if (type->kind == CORTO_SEQUENCE) {
+            ref = corto_genDepRefsAppend(
+                refs, CORTO_GENDEP_REF_SEQUENCE, offset);
+        } else {
+            goto unsupported;
+        }
 
-    /* Insert dependencies on references in the object-value */
-    s = corto_genDepSerializer();
-    if (corto_walk(&s, o, &walkData)) {
-        goto error;
+        ref->stride = stride;
+        ref->element = element;
+        break;
+    }
+    default:
+        goto unsupported;
     }
-    data->anonymousObjects = walkData.anonymousObjects;
 
-    return 1;
-error:
     return 0;
+unsupported:
+    return -1;
 }
 
-
+/* Get reference table for type. Tables are created once per type. */
 static
-int corto_genDeclareAction(
-    corto_object o,
-    void* userData)
+corto_genDepRefs* corto_genDepRefsGet(
+    g_itemWalk_t data,
+    corto_type t)
 {
-    g_itemWalk_t data;
-    data = userData;
-    if (data->onDeclare) {
-        data->onDeclare(o, data->userData);
+    corto_genDepRefs *refs;
+    corto_uint32 slot, i;
+
+    if (data->typeSize) {
+        slot = corto_genDepRefsSlot(data->types, data->typeSize, t);
+        if (data->types[slot]) {
+            return data->types[slot];
+        }
     }
 
-    return 1;
-}
+    g_tableGrow(&data->types, data->typeCount, &data->typeSize,
+        sizeof(corto_genDepRefs*), CORTO_GENDEP_REFS_MIN_SIZE,
+        corto_genDepRefsHash, NULL);
 
-static
-int corto_genDefineAction(
-    corto_object o,
-    void* userData)
-{
+    /* Insert table before it is built, so that types with a collection of
+     * their own type find the table. */
+    refs = corto_calloc(sizeof(corto_genDepRefs));
+    refs->type = t;
+    slot = corto_genDepRefsSlot(data->types, data->typeSize, t);
+    data->types[slot] = refs;
+    data->typeCount ++;
+
+    if (corto_genDepRefsAddValue(data, refs, t, 0)) {
+        refs->walk = TRUE;
+    }
+
+    for (i = 0; i < refs->count && !refs->walk; i ++) {
+        if (refs->refs[i].element && refs->refs[i].element->walk) {
+            refs->walk = TRUE;
+        }
+    }
+
+    if (refs->walk) {
+        refs->count = 0;
+    }
+
+    refs->done = TRUE;
+
+    return refs;
+}
+
+/* Free reference tables */
+static
+void corto_genDepRefsFree(
+    g_itemWalk_t data)
+{
+    corto_uint32 i;
+
+    for (i = 0; i < data->typeSize; i ++) {
+        corto_genDepRefs *refs = data->types[i];
+        if (refs) {
+            if (refs->refs) {
+                corto_dealloc(refs->refs);
+            }
+            corto_dealloc(refs);
+        }
+    }
+
+    if (data->types) {
+        corto_dealloc(data->types);
+    }
+}
+
+static
+int corto_genDepRefsWalk(
+    g_depWalk_t data,
+    corto_genDepRefs *refs,
+    char *ptr);
+
+/* Add dependencies on references in elements */
+static
+int corto_genDepRefsWalkElements(
+    g_depWalk_t data,
+    corto_genDepRef *ref,
+    char *ptr,
+    corto_uint32 count)
+{
+    corto_uint32 i;
+    int ret;
+
+    for (i = 0; i < count; i ++) {
+        char *elem = ptr + i * ref->stride;
+        if (!ref->element) {
+            if (corto_genDepReferenceExt(data, *(corto_object*)elem, NULL)) {
+                return -1;
+            }
+        } else if ((ret = corto_genDepRefsWalk(data, ref->element, elem))) {
+            return ret;
+        }
+    }
+
+    return 0;
+}
+
+/* Add dependencies on references at locations in reference table. Returns 1
+ * if the value must be walked with corto_walk. */
+static
+int corto_genDepRefsWalk(
+    g_depWalk_t data,
+    corto_genDepRefs *refs,
+    char *ptr)
+{
+    corto_uint32 i;
+    int ret = 0;
+
+    if (refs->walk) {
+        return 1;
+    }
+
+    for (i = 0; i < refs->count && !ret; i ++) {
+        corto_genDepRef *ref = &refs->refs[i];
+        char *field = ptr + ref->offset;
+
+        switch(ref->kind) {
+        case CORTO_GENDEP_REF_MEMBER:
+            ret = corto_genDepReferenceExt(
+                data, *(corto_object*)field, ref->member);
+            break;
+        case CORTO_GENDEP_REF_ARRAY:
+            ret = corto_genDepRefsWalkElements(data, ref, field, ref->count);
+            break;
+        case CORTO_GENDEP_REF_SEQUENCE: {
+            corto_genDepSeq *seq = (corto_genDepSeq*)field;
+            ret = corto_genDepRefsWalkElements(
+                data, ref, seq->buffer, seq->length);
+            break;
+        }
+        }
+    }
+
+    return ret;
+}
+
+/* Add dependencies for function arguments */
+static
+int corto_genDepBuildProc(
+    corto_function f,
+    struct g_depWalk_t* data)
+{
+    corto_uint32 i;
+    corto_type t;
+
+    for(i=0; i<f->parameters.length; i++) {
+        t = f->parameters.buffer[i].type;
+        if (corto_genDepMustParse(data->data, t)) {
+            t = corto_genDepFindAnonymous(data, t);
+
+            /* Type must be at least declared when the function is declared. */
+            corto_genDepAdd(
+                data->data,
+                f,
+                CORTO_DECLARED,
+                t,
+                CORTO_DECLARED | CORTO_VALID);
+        }
+    }
+
+    return 0;
+}
+
+/* Build dependency-administration for object */
+static
+int corto_genDepBuildAction(
+    corto_object o,
+    void* userData)
+{
+    g_itemWalk_t data;
+    struct g_depWalk_t walkData;
+    corto_genDepRefs *refs;
+    corto_object parent = NULL;
+    int ret;
+
+    if (corto_check_attr(o, CORTO_ATTR_NAMED)) {
+        parent = corto_parentof(o);
+    }
+
+    data = userData;
+
+    walkData.o = o;
+    walkData.data = data;
+
+    /* Object can be declared only after its type is defined. */
+    if (corto_genDepMustParse(data, corto_typeof(o))) {
+        corto_type t = corto_genDepFindAnonymous(&walkData, corto_typeof(o));
+        corto_genDepAdd(data, o, CORTO_DECLARED, t, CORTO_VALID);
+    }
+
+    /* TODO: this is not nice */
+    if (corto_class_instanceof(corto_procedure_o, corto_typeof(o))) {
+        /* Insert base-dependency: methods may only be declared after the base
+         * of a class has been defined. */
+        if (corto_typeof(o) != corto_type(corto_function_o)) {
+            if (corto_class_instanceof(corto_class_o, parent) &&
+                corto_interface(parent)->base)
+            {
+                if (corto_genDepMustParse(data, corto_interface(parent)->base)) {
+                    corto_genDepAdd(
+                        data,
+                        o,
+                        CORTO_DECLARED,
+                        corto_interface(parent)->base,
+                        CORTO_VALID);
+                }
+            }
+        }
+
+        /* Add dependencies on function parameters - types must be declared
+         * before function is declared. */
+        if (corto_genDepBuildProc(corto_function(o), &walkData)) {
+            goto error;
+        }
+    }
+
+    /* Insert dependency on parent */
+    if (corto_check_attr(o, CORTO_ATTR_NAMED) && corto_parentof(o)) {
+        if (parent != root_o) { /* Root is always available */
+            corto_int8 parentState =
+                corto_type(corto_typeof(o))->parent_state;
+
+            corto_genDepAdd(data, o, CORTO_DECLARED, parent, parentState);
+            if (parentState == CORTO_DECLARED) {
+                corto_genDepAdd(data, parent, CORTO_VALID, o, CORTO_VALID);
+            }
+        }
+    }
+
+    /* Guard to ensure that the object is added to the dependency
+     * administration */
+    corto_genDepInsert(data, o);
+
+    /* Insert dependencies on references in the object-value. Only locations
+     * that can hold references are visited, unless the type has values that
+     * the reference table cannot describe. */
+    ret = 1;
+    if (!data->walkValues) {
+        refs = corto_genDepRefsGet(data, corto_typeof(o));
+        ret = corto_genDepRefsWalk(&walkData, refs, o);
+    }
+    if (ret < 0) {
+        goto error;
+    } else if (ret) {
+        corto_walk_opt s = corto_genDepSerializer();
+        if (corto_walk(&s, o, &walkData)) {
+            goto error;
+        }
+    }
+    corto_genDepFlush(data);
+
+    return 1;
+error:
+    return 0;
+}
+
+
+static
+int corto_genDeclareAction(
+    corto_object o,
+    void* userData)
+{
+    g_itemWalk_t data;
+    data = userData;
+    if (data->onDeclare) {
+        data->onDeclare(o, data->userData);
+    }
+
+    return 1;
+}
+
+static
+int corto_genDefineAction(
+    corto_object o,
+    void* userData)
+{
     g_itemWalk_t data;
     data = userData;
     if ((corto_typeof(o)->kind != CORTO_VOID) || (corto_typeof(o)->reference)) {
@@ -322,44 +1001,928 @@ int corto_genDefineAction(
     return 1;
 }
 
-int corto_genDepWalk(
+#define CORTO_GEN_HASH_INIT (0xcbf29ce484222325ULL)
+#define CORTO_GEN_FINGERPRINT_MIN_SIZE (64)
+
+/* Hash string (FNV-1a) */
+static
+uint64_t corto_genDepHash(
+    uint64_t hash,
+    const char *str)
+{
+    const char *ptr;
+
+    for (ptr = str; *ptr; ptr ++) {
+        hash ^= (unsigned char)*ptr;
+        hash *= 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
+/* Hash integer (FNV-1a over its bytes, least significant first) */
+static
+uint64_t corto_genDepHashValue(
+    uint64_t hash,
+    uint64_t value)
+{
+    corto_uint32 i;
+
+    for (i = 0; i < sizeof(uint64_t); i ++) {
+        hash ^= (value >> (i * 8)) & 0xff;
+        hash *= 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
+/* Name of object in dependency cache. Anonymous objects are stored by type
+ * and value, so that they can be found when the cache is loaded. */
+static
+char* corto_genDepCacheName(
+    void *o,
+    void *userData)
+{
+    corto_id id;
+    char *value, *result;
+
+    CORTO_UNUSED(userData);
+
+    if (corto_check_attr(o, CORTO_ATTR_NAMED) && corto_childof(root_o, o)) {
+        return ut_strdup(corto_fullpath(id, o));
+    }
+
+    value = corto_str(o, 0);
+    corto_fullpath(id, corto_typeof(o));
+    if (value && value[0] == '{') {
+        result = ut_asprintf("%s%s", id, value);
+    } else {
+        result = ut_asprintf("%s{%s}", id, value ? value : "");
+    }
+    corto_dealloc(value);
+
+    return result;
+}
+
+/* Anonymous object in dependency cache */
+typedef struct corto_genDepCacheEntry {
+    char *name;
+    uint64_t hash;
+    corto_object o;
+} corto_genDepCacheEntry;
+
+/* Type that is added to the fingerprint */
+typedef struct corto_genDepTypeEntry {
+    corto_type type;
+    uint64_t hash; /* Hash of metadata, 0 while type is being hashed */
+} corto_genDepTypeEntry;
+
+/* Fingerprint of the inputs that dependencies are extracted from: the parse
+ * list, the paths and types of walked objects, the metadata of their types
+ * and the contents of the source files that objects are loaded from. Object
+ * values are not read, so the sources must describe them. Anonymous types are
+ * collected, so that loading the cache can find them without walking values.
+ * Other anonymous objects are only reachable through values, so a graph that
+ * contains them is not stored. */
+struct corto_genDepFingerprint_t {
+    g_generator g;
+    uint64_t objects; /* Sum of hashes, so order of walking does not matter */
+    corto_genDepTypeEntry *types; /* Open addressing table of hashed types */
+    corto_uint32 typeCount;
+    corto_uint32 typeSize;
+    corto_genDepCacheEntry *anonymous; /* Open addressing table by name */
+    corto_uint32 anonymousCount;
+    corto_uint32 anonymousSize;
+    corto_bool complete; /* Every anonymous object in graph was collected */
+};
+
+/* Find slot for type in table of hashed types */
+static
+corto_uint32 corto_genDepFingerprintTypeSlot(
+    corto_genDepTypeEntry *types,
+    corto_uint32 size,
+    corto_type t)
+{
+    corto_uint32 mask = size - 1;
+    corto_uint32 slot = g_ptrHash(t) & mask;
+
+    while (types[slot].type && types[slot].type != t) {
+        slot = (slot + 1) & mask;
+    }
+
+    return slot;
+}
+
+/* Hash of entry in table of hashed types, for rehashing */
+static
+corto_uint32 corto_genDepFingerprintTypeHash(
+    const void *entry,
+    void *ctx)
+{
+    CORTO_UNUSED(ctx);
+    return g_ptrHash(((const corto_genDepTypeEntry*)entry)->type);
+}
+
+/* Find type in table of hashed types. Returns NULL if type is not hashed. */
+static
+corto_genDepTypeEntry* corto_genDepFingerprintTypeFind(
+    corto_genDepFingerprint_t *data,
+    corto_type t)
+{
+    corto_genDepTypeEntry *entry;
+
+    if (!data->typeSize) {
+        return NULL;
+    }
+
+    entry = &data->types[
+        corto_genDepFingerprintTypeSlot(data->types, data->typeSize, t)];
+
+    return entry->type ? entry : NULL;
+}
+
+/* Add type to table of hashed types */
+static
+corto_genDepTypeEntry* corto_genDepFingerprintTypeAdd(
+    corto_genDepFingerprint_t *data,
+    corto_type t)
+{
+    corto_genDepTypeEntry *entry;
+
+    g_tableGrow(&data->types, data->typeCount, &data->typeSize,
+        sizeof(corto_genDepTypeEntry), CORTO_GEN_FINGERPRINT_MIN_SIZE,
+        corto_genDepFingerprintTypeHash, NULL);
+
+    entry = &data->types[
+        corto_genDepFingerprintTypeSlot(data->types, data->typeSize, t)];
+    entry->type = t;
+    entry->hash = 0;
+    data->typeCount ++;
+
+    return entry;
+}
+
+/* Find slot for name in table of anonymous objects */
+static
+corto_uint32 corto_genDepCacheSlot(
+    corto_genDepCacheEntry *entries,
+    corto_uint32 size,
+    const char *name,
+    uint64_t hash)
+{
+    corto_uint32 mask = size - 1;
+    corto_uint32 slot = (corto_uint32)(hash >> 32) & mask;
+
+    while (entries[slot].name &&
+        (entries[slot].hash != hash || strcmp(entries[slot].name, name)))
+    {
+        slot = (slot + 1) & mask;
+    }
+
+    return slot;
+}
+
+/* Hash of anonymous object in table, for rehashing */
+static
+corto_uint32 corto_genDepCacheHash(
+    const void *entry,
+    void *ctx)
+{
+    CORTO_UNUSED(ctx);
+    return (corto_uint32)(((const corto_genDepCacheEntry*)entry)->hash >> 32);
+}
+
+/* Add anonymous object to table. If an object with the same name was already
+ * added, name is deallocated. */
+static
+void corto_genDepCacheAdd(
+    corto_genDepFingerprint_t *data,
+    char *name,
+    corto_object o)
+{
+    uint64_t hash = corto_genDepHash(CORTO_GEN_HASH_INIT, name);
+    corto_genDepCacheEntry *entry;
+
+    if (data->anonymousSize) {
+        entry = &data->anonymous[corto_genDepCacheSlot(
+            data->anonymous, data->anonymousSize, name, hash)];
+        if (entry->name) {
+            corto_dealloc(name);
+            return;
+        }
+    }
+
+    g_tableGrow(&data->anonymous, data->anonymousCount, &data->anonymousSize,
+        sizeof(corto_genDepCacheEntry), CORTO_GEN_FINGERPRINT_MIN_SIZE,
+        corto_genDepCacheHash, NULL);
+
+    entry = &data->anonymous[corto_genDepCacheSlot(
+        data->anonymous, data->anonymousSize, name, hash)];
+    entry->name = name;
+    entry->hash = hash;
+    entry->o = o;
+    data->anonymousCount ++;
+}
+
+/* Free fingerprint administration */
+static
+void corto_genDepFingerprintFree(
+    corto_genDepFingerprint_t *data)
+{
+    corto_uint32 i;
+
+    for (i = 0; i < data->anonymousSize; i ++) {
+        if (data->anonymous[i].name) {
+            corto_dealloc(data->anonymous[i].name);
+        }
+    }
+    if (data->anonymous) {
+        corto_dealloc(data->anonymous);
+    }
+    if (data->types) {
+        corto_dealloc(data->types);
+    }
+}
+
+static
+uint64_t corto_genDepFingerprintType(
+    corto_genDepFingerprint_t *data,
+    corto_type t);
+
+/* Hash reference to type. Named types are hashed by name, as their metadata is
+ * added to the fingerprint by itself. Anonymous types are hashed by their
+ * metadata, as they have no name. */
+static
+uint64_t corto_genDepFingerprintRef(
+    corto_genDepFingerprint_t *data,
+    uint64_t hash,
+    corto_type t)
+{
+    uint64_t typeHash;
+    corto_id id;
+
+    if (!t) {
+        return corto_genDepHashValue(hash, 0);
+    }
+
+    typeHash = corto_genDepFingerprintType(data, t);
+    if (corto_genDepIsAnonymous(t)) {
+        return corto_genDepHashValue(hash, typeHash);
+    } else {
+        return corto_genDepHash(hash, corto_fullpath(id, t));
+    }
+}
+
+/* Add metadata of type to fingerprint, and return its hash. Only the parts of
+ * a type that dependencies are derived from are hashed, which includes types
+ * that are not parsed. Each type is hashed once. */
+static
+uint64_t corto_genDepFingerprintType(
+    corto_genDepFingerprint_t *data,
+    corto_type t)
+{
+    corto_genDepTypeEntry *entry = corto_genDepFingerprintTypeFind(data, t);
+    uint64_t hash = CORTO_GEN_HASH_INIT;
+    corto_bool anonymous = corto_genDepIsAnonymous(t);
+    corto_id id;
+
+    /* A type that is being hashed is reached from its own metadata. This can
+     * only happen for named types, which are referred to by name. */
+    if (entry) {
+        return entry->hash;
+    }
+
+    corto_genDepFingerprintTypeAdd(data, t);
+
+    if (!anonymous) {
+        hash = corto_genDepHash(hash, corto_fullpath(id, t));
+    }
+    hash = corto_genDepHashValue(hash, t->kind);
+    hash = corto_genDepHashValue(hash, t->reference);
+    hash = corto_genDepHashValue(hash, t->parent_state);
+    hash = corto_genDepFingerprintRef(data, hash, corto_typeof(t));
+
+    if (t->kind == CORTO_COMPOSITE) {
+        corto_interface type = corto_interface(t);
+        corto_uint32 i;
+
+        hash = corto_genDepHashValue(hash, type->kind);
+        hash = corto_genDepFingerprintRef(data, hash, corto_type(type->base));
+
+        for (i = 0; i < type->members.length; i ++) {
+            corto_member m = type->members.buffer[i];
+
+            hash = corto_genDepHash(hash, corto_idof(m));
+            hash = corto_genDepFingerprintRef(data, hash, corto_typeof(m));
+            hash = corto_genDepFingerprintRef(data, hash, m->type);
+            hash = corto_genDepHashValue(hash, m->modifiers);
+            hash = corto_genDepHashValue(hash, m->state);
+            hash = corto_genDepHash(
+                hash, m->stateCondExpr ? m->stateCondExpr : "");
+        }
+    } else if (t->kind == CORTO_COLLECTION) {
+        corto_collection type = corto_collection(t);
+
+        hash = corto_genDepHashValue(hash, type->kind);
+        hash = corto_genDepHashValue(hash, type->max);
+        hash = corto_genDepFingerprintRef(data, hash, type->element_type);
+        if (type->kind == CORTO_MAP) {
+            hash = corto_genDepFingerprintRef(
+                data, hash, corto_map(t)->key_type);
+        }
+    }
+
+    /* Table may have grown while hashing metadata */
+    entry = corto_genDepFingerprintTypeFind(data, t);
+    entry->hash = hash;
+    data->objects += hash;
+
+    /* Anonymous types can be in the dependency graph. Equal types are
+     * collected once, through the intern table. */
+    if (anonymous && g_mustParse(data->g, t)) {
+        corto_object o = g_anonymousIntern(data->g, t, NULL);
+        corto_genDepCacheAdd(data, corto_genDepCacheName(o, NULL), o);
+    }
+
+    return hash;
+}
+
+/* Add object to fingerprint. Hashes of objects are added, so the fingerprint
+ * does not depend on the order in which scopes are walked. Values are not
+ * read, except for the metadata of types and functions. */
+static
+int corto_genDepFingerprintAction(
+    corto_object o,
+    void* userData)
+{
+    corto_genDepFingerprint_t *data = userData;
+    uint64_t hash = CORTO_GEN_HASH_INIT;
+    corto_id id;
+
+    hash = corto_genDepHash(hash, corto_fullpath(id, o));
+    hash = corto_genDepFingerprintRef(data, hash, corto_typeof(o));
+
+    /* Dependencies also depend on the metadata of types that are parsed, and
+     * on the types of function parameters */
+    if (corto_instanceof(corto_type_o, o)) {
+        hash = corto_genDepFingerprintRef(data, hash, corto_type(o));
+    } else if (corto_class_instanceof(corto_procedure_o, corto_typeof(o))) {
+        corto_function f = corto_function(o);
+        corto_uint32 i;
+
+        hash = corto_genDepFingerprintRef(data, hash, f->return_type);
+        for (i = 0; i < f->parameters.length; i ++) {
+            hash = corto_genDepFingerprintRef(
+                data, hash, f->parameters.buffer[i].type);
+        }
+    }
+
+    data->objects += hash;
+
+    return 1;
+}
+
+/* Add contents of the source files that objects are loaded from. Files are
+ * listed in the "depsources" attribute, separated by commas. Returns -1 if a
+ * file cannot be loaded. */
+static
+int16_t corto_genDepFingerprintSources(
+    uint64_t *hash,
+    const char *sources)
+{
+    const char *ptr = sources;
+
+    while (*ptr) {
+        const char *end = strchr(ptr, ',');
+        corto_uint32 length = end ? end - ptr : strlen(ptr);
+        char *file = ut_asprintf("%.*s", length, ptr);
+        char *content = ut_file_load(file);
+
+        if (!content) {
+            /* A mistyped path would leave changes to the objects undetected */
+            ut_catch();
+            ut_trace("dependency cache disabled: cannot load '%s'", file);
+            corto_dealloc(file);
+            return -1;
+        }
+
+        *hash = corto_genDepHash(*hash, file);
+        *hash = corto_genDepHash(*hash, content);
+        corto_dealloc(content);
+        corto_dealloc(file);
+
+        ptr += length;
+        if (*ptr) {
+            ptr ++;
+        }
+    }
+
+    return 0;
+}
+
+/* Fingerprint of the inputs that dependencies are extracted from. Returns -1
+ * if the fingerprint cannot be computed. */
+static
+int16_t corto_genDepFingerprint(
     g_generator g,
-    corto_depresolver_action onDeclare,
-    corto_depresolver_action onDefine,
+    corto_genDepFingerprint_t *data,
+    uint64_t *key)
+{
+    uint64_t result = CORTO_GEN_HASH_INIT;
+
+    memset(data, 0, sizeof(corto_genDepFingerprint_t));
+    data->g = g;
+    data->complete = TRUE;
+
+    if (g->objects) {
+        ut_iter it = ut_ll_iter(g->objects);
+        while (ut_iter_hasNext(&it)) {
+            g_object *obj = ut_iter_next(&it);
+            corto_id id;
+            result = corto_genDepHash(result, corto_fullpath(id, obj->o));
+            result = corto_genDepHash(result, obj->parseSelf ? "1" : "0");
+            result = corto_genDepHash(result, obj->parseScope ? "1" : "0");
+        }
+    }
+
+    if (corto_genDepFingerprintSources(
+        &result, g_getAttribute(g, "depsources")))
+    {
+        return -1;
+    }
+
+    g_walkRecursive(g, corto_genDepFingerprintAction, data);
+    *key = corto_genDepHashValue(result, data->objects);
+
+    return 0;
+}
+
+/* Test if anonymous object in graph was collected by fingerprint. Objects in
+ * the graph are interned, so they are the objects that were collected. */
+static
+void corto_genDepFingerprintCheck(
+    corto_genDepFingerprint_t *data,
+    corto_object o)
+{
+    if (corto_genDepIsAnonymous(o) &&
+        (!corto_instanceof(corto_type_o, o) ||
+         !corto_genDepFingerprintTypeFind(data, corto_type(o))))
+    {
+        data->complete = FALSE;
+    }
+}
+
+/* Find object from dependency cache. Named objects are looked up, anonymous
+ * objects must have been found by the fingerprint, so that loading the cache
+ * does not create objects. */
+static
+void* corto_genDepCacheLookup(
+    const char *name,
+    void *userData)
+{
+    corto_genDepFingerprint_t *data = userData;
+    uint64_t hash = corto_genDepHash(CORTO_GEN_HASH_INIT, name);
+    corto_object o;
+
+    if (data->anonymousSize) {
+        corto_genDepCacheEntry *entry = &data->anonymous[corto_genDepCacheSlot(
+            data->anonymous, data->anonymousSize, name, hash)];
+        if (entry->name) {
+            return entry->o;
+        }
+    }
+
+    o = corto_lookup(NULL, (char*)name);
+    if (o) {
+        /* Named objects are kept alive by their scope */
+        corto_release(o);
+    }
+
+    return o;
+}
+
+/* Store dependency graph in hidden directory */
+static
+void corto_genDepCacheSave(
+    g_generator g,
+    corto_depresolver resolver,
+    const char *file,
+    uint64_t key)
+{
+    char *hidden = g_getAttribute(g, "hidden");
+    if (!hidden[0]) {
+        hidden = ".corto";
+    }
+
+    if (ut_file_test(hidden) != 1) {
+        if (ut_mkdir(hidden)) {
+            goto error;
+        }
+    }
+
+    if (corto_depresolver_save(
+        resolver, file, key, corto_genDepCacheName, g))
+    {
+        goto error;
+    }
+
+    return;
+error:
+    ut_catch();
+    ut_warning("failed to store dependency cache '%s'", file);
+}
+
+/* Top-level object to extract dependencies from */
+typedef struct corto_genDepObject {
+    corto_object o;
+    g_object *current; /* Generator object that object is parsed for */
+    corto_uint32 worker; /* Worker that recorded dependencies of object */
+    corto_uint32 first; /* First record of object in records of worker */
+    corto_uint32 count;
+    corto_bool failed;
+} corto_genDepObject;
+
+typedef struct corto_genDepPool corto_genDepPool;
+
+/* Thread that extracts dependencies */
+typedef struct corto_genDepWorker {
+    struct g_itemWalk_t data;
+    corto_genDepPool *pool;
+    corto_uint32 index;
+    ut_thread thread;
+} corto_genDepWorker;
+
+struct corto_genDepPool {
+    g_generator g;
+    corto_genDepObject *objects; /* In order of the serial walk */
+    corto_uint32 count;
+    corto_uint32 size;
+    corto_uint32 next; /* Next object to extract */
+    struct ut_mutex_s lock;
+    corto_genDepWorker *workers;
+    corto_uint32 workerCount;
+};
+
+/* Collect objects in order of the serial walk */
+static
+int corto_genDepCollect(
+    corto_object o,
     void* userData)
+{
+    corto_genDepPool *pool = userData;
+    corto_genDepObject *obj;
+
+    if (pool->count == pool->size) {
+        pool->size = pool->size ? pool->size * 2 : 256;
+        pool->objects = corto_realloc(
+            pool->objects, pool->size * sizeof(corto_genDepObject));
+    }
+
+    obj = &pool->objects[pool->count ++];
+    obj->o = o;
+    obj->current = pool->g->current;
+    obj->worker = 0;
+    obj->first = 0;
+    obj->count = 0;
+    obj->failed = FALSE;
+
+    return 1;
+}
+
+/* Extract dependencies of objects until all objects are taken */
+static
+void* corto_genDepWorkerMain(
+    void *arg)
+{
+    corto_genDepWorker *worker = arg;
+    corto_genDepPool *pool = worker->pool;
+    corto_uint32 i, end;
+
+    for (;;) {
+        ut_mutex_lock(&pool->lock);
+        i = pool->next;
+        if (i < pool->count) {
+            pool->next += CORTO_GENDEP_CHUNK;
+        }
+        ut_mutex_unlock(&pool->lock);
+
+        if (i >= pool->count) {
+            break;
+        }
+
+        end = i + CORTO_GENDEP_CHUNK;
+        if (end > pool->count) {
+            end = pool->count;
+        }
+
+        for (; i < end; i ++) {
+            corto_genDepObject *obj = &pool->objects[i];
+            worker->data.current = obj->current;
+            obj->worker = worker->index;
+            obj->first = worker->data.recordCount;
+            if (!corto_genDepBuildAction(obj->o, &worker->data)) {
+                /* Error is reported when records are merged */
+                ut_catch();
+                obj->failed = TRUE;
+            }
+            obj->count = worker->data.recordCount - obj->first;
+        }
+    }
+
+    return NULL;
+}
+
+/* Free objects and records of workers */
+static
+void corto_genDepPoolFree(
+    corto_genDepPool *pool)
+{
+    corto_uint32 i;
+
+    for (i = 0; i < pool->workerCount; i ++) {
+        corto_genDepWorker *worker = &pool->workers[i];
+        if (worker->data.records) {
+            corto_dealloc(worker->data.records);
+        }
+        if (worker->data.conds) {
+            corto_dealloc(worker->data.conds);
+        }
+        corto_genDepRefsFree(&worker->data);
+    }
+    if (pool->workers) {
+        corto_dealloc(pool->workers);
+    }
+    if (pool->objects) {
+        corto_dealloc(pool->objects);
+    }
+}
+
+/* Extract dependencies with worker threads. Records are added to the resolver
+ * in the order of the serial walk, so the resolver gets the same items and
+ * dependencies in the same order as a serial build. */
+static
+int corto_genDepBuildParallel(
+    g_itemWalk_t data,
+    corto_uint32 workerCount)
+{
+    g_generator g = data->g;
+    g_object *current = g->current;
+    corto_genDepPool pool;
+    corto_uint32 i, r;
+
+    memset(&pool, 0, sizeof(pool));
+    pool.g = g;
+    if (!g_walkRecursive(g, corto_genDepCollect, &pool)) {
+        goto error;
+    }
+
+    ut_mutex_new(&pool.lock);
+    pool.workers = corto_calloc(workerCount * sizeof(corto_genDepWorker));
+    pool.workerCount = workerCount;
+    for (i = 0; i < workerCount; i ++) {
+        corto_genDepWorker *worker = &pool.workers[i];
+        worker->data.g = g;
+        worker->data.walkValues = data->walkValues;
+        worker->pool = &pool;
+        worker->index = i;
+        worker->thread = ut_thread_new(corto_genDepWorkerMain, worker);
+    }
+    for (i = 0; i < workerCount; i ++) {
+        ut_thread_join(pool.workers[i].thread, NULL);
+    }
+    ut_mutex_free(&pool.lock);
+
+    for (i = 0; i < pool.count; i ++) {
+        corto_genDepObject *obj = &pool.objects[i];
+        corto_genDepRecord *records = pool.workers[obj->worker].data.records;
+
+        /* Extract dependencies again, so the error is reported */
+        if (obj->failed) {
+            g->current = obj->current;
+            if (!corto_genDepBuildAction(obj->o, data)) {
+                goto error;
+            }
+            g->current = current;
+            continue;
+        }
+
+        for (r = obj->first; r < obj->first + obj->count; r ++) {
+            corto_genDepRecord *record = &records[r];
+            corto_object dependent = record->dependent;
+            corto_object dependency = record->dependency;
+
+            if (record->dependentAnonymous) {
+                dependent = g_anonymousIntern(g, dependent, NULL);
+            }
+
+            if (!dependency) {
+                corto_genDepInsert(data, dependent);
+            } else {
+                if (record->dependencyAnonymous) {
+                    dependency = g_anonymousIntern(g, dependency, NULL);
+                }
+                corto_genDepAdd(data, dependent, record->kind, dependency,
+                    record->dependencyKind);
+            }
+        }
+        corto_genDepFlush(data);
+    }
+
+    corto_genDepPoolFree(&pool);
+    return 0;
+error:
+    g->current = current;
+    corto_genDepPoolFree(&pool);
+    return -1;
+}
+
+corto_depresolver corto_genDepBuild(
+    g_generator g)
 {
     struct g_itemWalk_t walkData;
-    corto_depresolver resolver = corto_depresolverCreate(
-        corto_genDeclareAction, corto_genDefineAction, &walkData);
+    corto_depresolver_opt opt;
+    corto_depresolver resolver;
     bool bootstrap = !strcmp(g_getAttribute(g, "bootstrap"), "true");
+    bool cache = !bootstrap && !strcmp(g_getAttribute(g, "depcache"), "true");
+    corto_uint32 workers = atoi(g_getAttribute(g, "depworkers"));
+    corto_genDepFingerprint_t fingerprint;
+    corto_id cacheFile;
+    uint64_t key = 0;
+
+    /* Print objects in scope order, so generated code does not depend on the
+     * order in which objects are found. Anonymous objects are ordered by type
+     * and value, as they have no path. */
+    corto_depresolver_opt_init(&opt);
+    opt.flags = CORTO_DEPRESOLVER_ORDERED;
+    opt.name = corto_genDepCacheName;
+    resolver = corto_depresolverCreateExt(&opt);
+
+    /* Without source files, a change to an object value cannot be detected
+     * without reading the value. The files must describe every value in the
+     * graph: a value that is set by code, or that is defined by an imported
+     * package that is not listed, does not change the fingerprint. */
+    if (cache && !g_getAttribute(g, "depsources")[0]) {
+        ut_trace("dependency cache disabled: no depsources");
+        cache = FALSE;
+    }
+
+    /* If the inputs of the dependency graph did not change since the graph was
+     * cached, load the graph instead of extracting dependencies from object
+     * values. */
+    if (cache && corto_genDepFingerprint(g, &fingerprint, &key)) {
+        cache = FALSE;
+    }
+    if (cache) {
+        int ret;
+
+        g_hiddenFilePath(g, cacheFile, "depcache");
+        ret = corto_depresolver_load(
+            resolver, cacheFile, key, corto_genDepCacheLookup, &fingerprint);
+        if (!ret) {
+            corto_genDepFingerprintFree(&fingerprint);
+            return resolver;
+        } else if (ret == -1) {
+            ut_catch();
+            ut_warning("ignoring invalid dependency cache '%s'", cacheFile);
+            corto_depresolver_free(resolver);
+            resolver = corto_depresolverCreateExt(&opt);
+        }
+    }
 
     /* Prepare walkData */
     walkData.g = g;
-    walkData.userData = userData;
+    walkData.userData = NULL;
     walkData.resolver = resolver;
-    walkData.onDefine = onDefine;
-    walkData.onDeclare = onDeclare;
+    walkData.onDefine = NULL;
+    walkData.onDeclare = NULL;
     walkData.bootstrap = FALSE;
-    walkData.anonymousObjects = NULL;
+    walkData.edges = NULL;
+    walkData.edgeCount = 0;
+    walkData.edgeSize = 0;
+    walkData.conds = NULL;
+    walkData.condCount = 0;
+    walkData.condSize = 0;
+    walkData.types = NULL;
+    walkData.typeCount = 0;
+    walkData.typeSize = 0;
+    walkData.walkValues = !strcmp(g_getAttribute(g, "deprefs"), "false");
+    walkData.fingerprint = cache ? &fingerprint : NULL;
+    walkData.current = NULL;
+    walkData.records = NULL;
+    walkData.recordCount = 0;
+    walkData.recordSize = 0;
 
-    /* Build dependency administration */
+    /* Build dependency administration. When generating for bootstrap,
+     * disregard dependencies. */
     if (!bootstrap) {
-        if (!g_walkRecursive(g, corto_genDepBuildAction, &walkData)) {
+        /* Values of objects are only read while extracting dependencies, so
+         * objects can be walked in parallel if configured. */
+        if (workers > 1) {
+            if (corto_genDepBuildParallel(&walkData, workers)) {
+                ut_trace("dependency-builder failed.");
+                goto error;
+            }
+        } else if (!g_walkRecursive(g, corto_genDepBuildAction, &walkData)) {
             ut_trace("dependency-builder failed.");
             goto error;
         }
-    } else {
-        /* When generating for bootstrap, disregard dependencies */
-        g_walkRecursive(g, corto_genDeclareAction, &walkData);
-        g_walkRecursive(g, corto_genDefineAction, &walkData);
+    }
 
+    /* A graph with anonymous objects that the fingerprint did not find cannot
+     * be loaded without reading values */
+    if (cache) {
+        if (fingerprint.complete) {
+            corto_genDepCacheSave(g, resolver, cacheFile, key);
+        }
+        corto_genDepFingerprintFree(&fingerprint);
     }
 
-    if (walkData.anonymousObjects) {
-        ut_ll_free(walkData.anonymousObjects);
+    corto_dealloc(walkData.edges);
+    if (walkData.conds) {
+        corto_dealloc(walkData.conds);
     }
+    corto_genDepRefsFree(&walkData);
+
+    return resolver;
+error:
+    if (cache) {
+        corto_genDepFingerprintFree(&fingerprint);
+    }
+    corto_dealloc(walkData.edges);
+    if (walkData.conds) {
+        corto_dealloc(walkData.conds);
+    }
+    corto_genDepRefsFree(&walkData);
+    corto_depresolver_free(resolver);
+    return NULL;
+}
+
+int corto_genDepWalkResolver(
+    g_generator g,
+    corto_depresolver resolver,
+    corto_depresolver_action onDeclare,
+    corto_depresolver_action onDefine,
+    void* userData)
+{
+    struct g_itemWalk_t walkData;
+    bool bootstrap = !strcmp(g_getAttribute(g, "bootstrap"), "true");
+
+    /* Prepare walkData */
+    walkData.g = g;
+    walkData.userData = userData;
+    walkData.resolver = resolver;
+    walkData.onDefine = onDefine;
+    walkData.onDeclare = onDeclare;
+    walkData.bootstrap = FALSE;
+    walkData.edges = NULL;
+    walkData.edgeCount = 0;
+    walkData.edgeSize = 0;
+    walkData.conds = NULL;
+    walkData.condCount = 0;
+    walkData.condSize = 0;
+    walkData.types = NULL;
+    walkData.typeCount = 0;
+    walkData.typeSize = 0;
+    walkData.walkValues = FALSE;
+    walkData.fingerprint = NULL;
+    walkData.current = NULL;
+    walkData.records = NULL;
+    walkData.recordCount = 0;
+    walkData.recordSize = 0;
+
+    if (bootstrap) {
+        /* When generating for bootstrap, disregard dependencies. Objects are
+         * declared before they are defined. */
+        g_walkAction actions[] = {corto_genDeclareAction, corto_genDefineAction};
+        void *actionData[] = {&walkData, &walkData};
+        g_walkMulti(g, actions, actionData, 2, G_WALK_RECURSIVE | G_WALK_PHASES);
+    }
+
+    corto_depresolver_setActions(
+        resolver, corto_genDeclareAction, corto_genDefineAction, &walkData);
 
     return corto_depresolver_walk(resolver);
+}
+
+int corto_genDepWalk(
+    g_generator g,
+    corto_depresolver_action onDeclare,
+    corto_depresolver_action onDefine,
+    void* userData)
+{
+    corto_depresolver resolver = corto_genDepBuild(g);
+    int result;
+
+    if (!resolver) {
+        goto error;
+    }
+
+    result = corto_genDepWalkResolver(
+        g, resolver, onDeclare, onDefine, userData);
+
+    corto_depresolver_free(resolver);
+
+    return result;
 error:
     return -1;
 }
@@ -20,11 +20,25 @@
  */
 
 #include <corto.g>
+#include "hash.h"
+
+#define CORTO_GENTYPE_SET_MIN_SIZE (64)
+#define CORTO_GENTYPE_CHUNK (256) /* Declarations per chunk */
+
+typedef struct corto_genTypeDeclaration corto_genTypeDeclaration;
 
 typedef struct corto_genTypeWalk_t {
     g_generator g;
-    ut_ll parsed; /* List of parsed types */
-    ut_ll declared; /* List of declared objects */
+    corto_object *parsed; /* Open addressing table of parsed named types */
+    corto_uint32 parsedCount;
+    corto_uint32 parsedSize; /* Always a power of two */
+    corto_bool *anonymousParsed; /* Parsed anonymous types, by intern index */
+    corto_uint32 anonymousParsedSize;
+    corto_genTypeDeclaration **declared; /* Open addressing table of declarations */
+    corto_uint32 declaredCount;
+    corto_uint32 declaredSize; /* Always a power of two */
+    corto_genTypeDeclaration **chunks; /* Declarations, chunks do not move */
+    corto_uint32 chunkCount;
     g_walkAction onDeclare;
     g_walkAction onDefine;
     g_walkAction onDeclareDefine;
@@ -32,30 +46,112 @@ typedef struct corto_genTypeWalk_t {
 }corto_genTypeWalk_t;
 
 static int corto_genTypeParse(corto_object o, corto_bool allowDeclared, corto_bool* recursion, corto_genTypeWalk_t* data);
-
-/* Mark type as parsed */
-static void corto_genTypeParsed(corto_object o, corto_genTypeWalk_t* data) {
-    ut_ll_insert(data->parsed, o);
-}
+static bool corto_isNamed(corto_object o);
 
 /* Mark object as declared */
-typedef struct corto_genTypeDeclaration {
+struct corto_genTypeDeclaration {
     corto_object o;
     corto_bool printed; /* If true, a forward declaration is printed in generated code. */
     corto_bool parsing; /* If true, then the object is currently being parsed and recursive
                         references can be checked. If false, this object only serves to
                         prevent re-declaring an object. */
-}corto_genTypeDeclaration;
+};
+
+/* Find slot for type in table of parsed types */
+static corto_uint32 corto_genTypeParsedSlot(corto_object *parsed, corto_uint32 size, corto_object o) {
+    corto_uint32 mask = size - 1;
+    corto_uint32 slot = g_ptrHash(o) & mask;
+
+    while (parsed[slot] && parsed[slot] != o) {
+        slot = (slot + 1) & mask;
+    }
+
+    return slot;
+}
+
+/* Find slot for object in table of declarations */
+static corto_uint32 corto_genTypeDeclaredSlot(corto_genTypeDeclaration **declared, corto_uint32 size, corto_object o) {
+    corto_uint32 mask = size - 1;
+    corto_uint32 slot = g_ptrHash(o) & mask;
+
+    while (declared[slot] && declared[slot]->o != o) {
+        slot = (slot + 1) & mask;
+    }
+
+    return slot;
+}
+
+/* Hash of parsed type, for rehashing */
+static corto_uint32 corto_genTypeParsedHash(const void *entry, void *ctx) {
+    CORTO_UNUSED(ctx);
+    return g_ptrHash(*(const corto_object*)entry);
+}
+
+/* Hash of declaration, for rehashing */
+static corto_uint32 corto_genTypeDeclaredHash(const void *entry, void *ctx) {
+    CORTO_UNUSED(ctx);
+    return g_ptrHash((*(corto_genTypeDeclaration* const*)entry)->o);
+}
+
+/* Mark type as parsed. Anonymous types are matched structurally, so they are
+ * marked by the index of their canonical object. */
+static void corto_genTypeParsed(corto_object o, corto_genTypeWalk_t* data) {
+    if (corto_isNamed(o)) {
+        corto_uint32 i;
+
+        g_tableGrow(&data->parsed, data->parsedCount, &data->parsedSize,
+            sizeof(corto_object), CORTO_GENTYPE_SET_MIN_SIZE,
+            corto_genTypeParsedHash, NULL);
+
+        i = corto_genTypeParsedSlot(data->parsed, data->parsedSize, o);
+        if (!data->parsed[i]) {
+            data->parsed[i] = o;
+            data->parsedCount ++;
+        }
+    } else {
+        corto_uint32 index;
+        g_anonymousIntern(data->g, o, &index);
+        if (index >= data->anonymousParsedSize) {
+            corto_uint32 size = data->anonymousParsedSize;
+            data->anonymousParsedSize = size ? size * 2 : 64;
+            while (index >= data->anonymousParsedSize) {
+                data->anonymousParsedSize *= 2;
+            }
+            data->anonymousParsed = corto_realloc(data->anonymousParsed,
+                data->anonymousParsedSize * sizeof(corto_bool));
+            memset(&data->anonymousParsed[size], 0,
+                (data->anonymousParsedSize - size) * sizeof(corto_bool));
+        }
+        data->anonymousParsed[index] = TRUE;
+    }
+}
 
+/* Add declaration for object. Declarations are allocated from chunks, which
+ * do not move, so that declarations can be held while others are added. */
 static corto_genTypeDeclaration* corto_genTypeDeclared(corto_object o, corto_genTypeWalk_t* data) {
     struct corto_genTypeDeclaration* decl;
+    corto_uint32 chunk = data->declaredCount / CORTO_GENTYPE_CHUNK;
+
+    g_tableGrow(&data->declared, data->declaredCount, &data->declaredSize,
+        sizeof(corto_genTypeDeclaration*), CORTO_GENTYPE_SET_MIN_SIZE,
+        corto_genTypeDeclaredHash, NULL);
+
+    if (chunk == data->chunkCount) {
+        data->chunkCount ++;
+        data->chunks = corto_realloc(data->chunks,
+            data->chunkCount * sizeof(corto_genTypeDeclaration*));
+        data->chunks[chunk] = corto_alloc(
+            CORTO_GENTYPE_CHUNK * sizeof(corto_genTypeDeclaration));
+    }
 
     /* Insert declaration object */
-    decl = corto_alloc(sizeof(struct corto_genTypeDeclaration));
+    decl = &data->chunks[chunk][data->declaredCount % CORTO_GENTYPE_CHUNK];
     decl->o = o;
     decl->printed = FALSE;
     decl->parsing = FALSE;
-    ut_ll_insert(data->declared, decl);
+    data->declared[corto_genTypeDeclaredSlot(
+        data->declared, data->declaredSize, o)] = decl;
+    data->declaredCount ++;
 
     return decl;
 }
@@ -66,30 +162,22 @@ static bool corto_isNamed(corto_object o) {
 
 /* Find type in parsed-list */
 static corto_bool corto_genTypeIsParsed(corto_object o, corto_genTypeWalk_t* data) {
-    ut_iter iter;
-    corto_object p;
     corto_bool found;
 
-    p = NULL;
     found = FALSE;
 
-    iter = ut_ll_iter(data->parsed);
-    while(!found && ut_iter_hasNext(&iter)) {
-        p = ut_iter_next(&iter);
-        /* If object is scoped, it must be matched exactly */
-        if (corto_isNamed(o)) {
-            if (o == p) {
-                found = TRUE;
-            }
-        /* If object is not scoped (anonymous), it is matched structurally */
-        } else {
-            if (!corto_isNamed(p)) {
-                if (corto_typeof(o) == corto_typeof(p)) {
-                    if (corto_compare(o, p) == CORTO_EQ) {
-                        found = TRUE;
-                    }
-                }
-            }
+    /* If object is scoped, it must be matched exactly */
+    if (corto_isNamed(o)) {
+        if (data->parsedSize) {
+            found = data->parsed[corto_genTypeParsedSlot(
+                data->parsed, data->parsedSize, o)] != NULL;
+        }
+    /* If object is not scoped (anonymous), it is matched structurally */
+    } else {
+        corto_uint32 index;
+        g_anonymousIntern(data->g, o, &index);
+        if (index < data->anonymousParsedSize) {
+            found = data->anonymousParsed[index];
         }
     }
 
@@ -98,19 +186,12 @@ static corto_bool corto_genTypeIsParsed(corto_object o, corto_genTypeWalk_t* dat
 
 /* Find type in declared-list */
 static struct corto_genTypeDeclaration* corto_genTypeIsDeclared(corto_object o, corto_genTypeWalk_t* data) {
-    ut_iter iter;
-    struct corto_genTypeDeclaration* p;
-
-    p = NULL;
-    iter = ut_ll_iter(data->declared);
-    while(ut_iter_hasNext(&iter)) {
-        p = ut_iter_next(&iter);
-        if (o == p->o) {
-            break;
-        }
+    if (!data->declaredSize) {
+        return NULL;
     }
 
-    return p ? (o == p->o) ? p : NULL : NULL;
+    return data->declared[corto_genTypeDeclaredSlot(
+        data->declared, data->declaredSize, o)];
 }
 
 /* Resolve any-dependencies */
@@ -506,6 +587,27 @@ error:
     return -1;
 }
 
+/* Free parsed types and declarations */
+static void corto_genTypeWalkFree(corto_genTypeWalk_t* data) {
+    corto_uint32 i;
+
+    if (data->parsed) {
+        corto_dealloc(data->parsed);
+    }
+    if (data->anonymousParsed) {
+        corto_dealloc(data->anonymousParsed);
+    }
+    if (data->declared) {
+        corto_dealloc(data->declared);
+    }
+    for (i = 0; i < data->chunkCount; i ++) {
+        corto_dealloc(data->chunks[i]);
+    }
+    if (data->chunks) {
+        corto_dealloc(data->chunks);
+    }
+}
+
 /* Walk objects, forward typedefs and types */
 static int corto_genTypeWalk(corto_object o, void* userData) {
     return !corto_genTypeParse(o, FALSE, NULL, userData);
@@ -520,12 +622,19 @@ int corto_genTypeDepWalk(
     void* userData)
 {
     corto_genTypeWalk_t walkData;
-    struct corto_genTypeDeclaration* decl;
 
     /* Prepare walkdata, open headerfile */
     walkData.g = g;
-    walkData.parsed = ut_ll_new();
-    walkData.declared = ut_ll_new();
+    walkData.parsed = NULL;
+    walkData.parsedCount = 0;
+    walkData.parsedSize = 0;
+    walkData.anonymousParsed = NULL;
+    walkData.anonymousParsedSize = 0;
+    walkData.declared = NULL;
+    walkData.declaredCount = 0;
+    walkData.declaredSize = 0;
+    walkData.chunks = NULL;
+    walkData.chunkCount = 0;
     walkData.onDeclare = onDeclare;
     walkData.onDefine = onDefine;
     walkData.onDeclareDefine = onDeclareDefine;
@@ -536,15 +645,10 @@ int corto_genTypeDepWalk(
         goto error;
     }
 
-    /* Free parsed-list */
-    ut_ll_free(walkData.parsed);
-
-    while((decl = ut_ll_takeFirst(walkData.declared))) {
-        corto_dealloc(decl);
-    }
-    ut_ll_free(walkData.declared);
+    corto_genTypeWalkFree(&walkData);
 
     return 0;
 error:
+    corto_genTypeWalkFree(&walkData);
     return -1;
 }
@@ -0,0 +1,84 @@
+/* Copyright (c) 2010-2018 the corto developers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <corto.g>
+#include "hash.h"
+
+/* Test if entry is empty. The first field of an entry is a pointer, or an
+ * index for entries that are smaller than a pointer. */
+static
+corto_bool g_tableEmpty(
+    const char *entry,
+    corto_uint32 entrySize)
+{
+    if (entrySize >= sizeof(void*)) {
+        return !*(void* const*)entry;
+    } else {
+        return !*(const corto_uint32*)entry;
+    }
+}
+
+void g_tableResize(
+    void *entries,
+    corto_uint32 *size,
+    corto_uint32 entrySize,
+    corto_uint32 minSize,
+    g_tableHashAction hash,
+    void *ctx)
+{
+    char **table = entries;
+    char *old = *table, *result;
+    corto_uint32 oldSize = *size, mask, i;
+
+    *size = oldSize ? oldSize * 2 : minSize;
+    mask = *size - 1;
+    result = corto_calloc(*size * entrySize);
+
+    if (entrySize == sizeof(void*)) {
+        /* Most tables store pointers, which can be moved without memcpy */
+        void **from = (void**)old, **to = (void**)result;
+        for (i = 0; i < oldSize; i ++) {
+            if (from[i]) {
+                corto_uint32 slot = hash(&from[i], ctx) & mask;
+                while (to[slot]) {
+                    slot = (slot + 1) & mask;
+                }
+                to[slot] = from[i];
+            }
+        }
+    } else {
+        for (i = 0; i < oldSize; i ++) {
+            char *entry = old + i * entrySize;
+            if (!g_tableEmpty(entry, entrySize)) {
+                corto_uint32 slot = hash(entry, ctx) & mask;
+                while (!g_tableEmpty(result + slot * entrySize, entrySize)) {
+                    slot = (slot + 1) & mask;
+                }
+                memcpy(result + slot * entrySize, entry, entrySize);
+            }
+        }
+    }
+
+    if (old) {
+        corto_dealloc(old);
+    }
+    *table = result;
+}
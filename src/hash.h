@@ -0,0 +1,87 @@
+/* Copyright (c) 2010-2018 the corto developers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* Hashing and open addressing tables, shared by the generator and the
+ * dependency resolver. Tables use linear probing and have a size that is a
+ * power of two. */
+
+#ifndef CORTO_G_HASH_H
+#define CORTO_G_HASH_H
+
+/* Hash pointer. Objects are aligned, so the low bits carry no information;
+ * the multiplication spreads the remaining bits. */
+static inline
+corto_uint32 g_ptrHash(
+    const void *o)
+{
+    corto_uint64 h = (corto_uint64)(uintptr_t)o;
+    h ^= h >> 4;
+    h *= 0x9E3779B97F4A7C15ULL;
+    return (corto_uint32)(h >> 32);
+}
+
+/* Hash pair of pointers */
+static inline
+corto_uint32 g_ptrPairHash(
+    const void *o1,
+    const void *o2)
+{
+    return g_ptrHash(o1) * 31 + g_ptrHash(o2);
+}
+
+/* Get hash of entry in table, see g_tableGrow */
+typedef corto_uint32 (*g_tableHashAction)(
+    const void *entry,
+    void *ctx);
+
+/* Double the size of table, or set it to minSize if the table is not yet
+ * allocated, and move entries to their slots in the new table. The first field
+ * of an entry is a pointer, or an index if the entry is smaller than a
+ * pointer, which is zero if the entry is empty. */
+void g_tableResize(
+    void *entries,
+    corto_uint32 *size,
+    corto_uint32 entrySize,
+    corto_uint32 minSize,
+    g_tableHashAction hash,
+    void *ctx);
+
+/* Make room for one more entry in table, resizing it if it would be more than
+ * 70% full. Returns TRUE if the table grew, in which case slots that were
+ * found before the call are no longer valid. */
+static inline
+corto_bool g_tableGrow(
+    void *entries,
+    corto_uint32 count,
+    corto_uint32 *size,
+    corto_uint32 entrySize,
+    corto_uint32 minSize,
+    g_tableHashAction hash,
+    void *ctx)
+{
+    if ((count + 1) * 10 <= *size * 7) {
+        return FALSE;
+    }
+    g_tableResize(entries, size, entrySize, minSize, hash, ctx);
+    return TRUE;
+}
+
+#endif
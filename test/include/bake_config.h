@@ -0,0 +1,31 @@
+/*
+                                   )
+                                  (.)
+                                  .|.
+                                  | |
+                              _.--| |--._
+                           .-';  ;`-'& ; `&.
+                          \   &  ;    &   &_/
+                           |"""---...---"""|
+                           \ | | | | | | | /
+                            `---.|.|.|.---'
+
+ * This file is generated by bake.lang.c for your convenience. Headers of
+ * dependencies will automatically show up in this file. Include bake_config.h
+ * in your main project file. Do not edit! */
+
+#ifndef CORTO_G_TEST_BAKE_CONFIG_H
+#define CORTO_G_TEST_BAKE_CONFIG_H
+
+/* Headers of public dependencies */
+#include <corto>
+#include <corto.g>
+#include <bake.util>
+
+/* Headers of private dependencies */
+#ifdef CORTO_G_TEST_IMPL
+/* No dependencies */
+#endif
+
+#endif
+
@@ -0,0 +1,1002 @@
+/* Copyright (c) 2010-2018 the corto developers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* Regression tests for the dependency walk of generators. Every test creates
+ * corto objects, parses them with one or more generators and compares the
+ * printed orders. */
+
+#include <corto.g.test>
+
+/* Object printed by a dependency walk */
+typedef struct test_printedObject {
+    corto_object o;
+    corto_bool defined;
+} test_printedObject;
+
+/* Objects in the order in which they were printed */
+typedef struct test_printed {
+    test_printedObject *objects;
+    corto_uint32 count;
+    corto_uint32 size;
+} test_printed;
+
+static
+void test_printedAdd(
+    test_printed *printed,
+    corto_object o,
+    corto_bool defined)
+{
+    if (printed->count == printed->size) {
+        printed->size = printed->size ? printed->size * 2 : 64;
+        printed->objects = corto_realloc(
+            printed->objects, printed->size * sizeof(test_printedObject));
+    }
+    printed->objects[printed->count].o = o;
+    printed->objects[printed->count].defined = defined;
+    printed->count ++;
+}
+
+static
+int test_onPrintedDeclare(
+    corto_object o,
+    void *userData)
+{
+    test_printedAdd(userData, o, FALSE);
+    return 1;
+}
+
+static
+int test_onPrintedDefine(
+    corto_object o,
+    void *userData)
+{
+    test_printedAdd(userData, o, TRUE);
+    return 1;
+}
+
+/* Test if object was printed */
+static
+corto_bool test_printedHas(
+    test_printed *printed,
+    corto_object o)
+{
+    corto_uint32 i;
+
+    for (i = 0; i < printed->count; i ++) {
+        if (printed->objects[i].o == o) {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/* Compare printed orders. Returns 0 if they are equal. */
+static
+int test_printedCompare(
+    const char *test,
+    test_printed *p1,
+    test_printed *p2)
+{
+    corto_uint32 i;
+
+    if (p1->count != p2->count) {
+        ut_error("%s: printed %u and %u objects", test, p1->count, p2->count);
+        return -1;
+    }
+
+    for (i = 0; i < p1->count; i ++) {
+        if (p1->objects[i].o != p2->objects[i].o ||
+            p1->objects[i].defined != p2->objects[i].defined)
+        {
+            corto_id id1, id2;
+            ut_error("%s: printed '%s' and '%s' at position %u",
+                test,
+                corto_fullpath(id1, p1->objects[i].o),
+                corto_fullpath(id2, p2->objects[i].o),
+                i);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/* Generators only parse objects that have the marker of the preprocessor as
+ * source, unless they generate for bootstrap, which disregards dependencies.
+ * Objects created until test_markerEnd get the marker as source. */
+static
+corto_object test_markerBegin(void)
+{
+    corto_object marker = corto_create(root_o, "pp_marker", corto_void_o);
+    corto_object prev = corto_set_source(marker);
+    corto_release(marker);
+    return prev;
+}
+
+static
+void test_markerEnd(
+    corto_object prev)
+{
+    corto_set_source(prev);
+}
+
+/* Build dependency graph for objects in order of the parse list, and print it.
+ * Objects are parsed without their scopes. */
+static
+int test_genPrint(
+    const char *test,
+    corto_object *parse,
+    corto_uint32 count,
+    test_printed *printed)
+{
+    g_generator g = g_new("test", NULL);
+    corto_depresolver resolver;
+    corto_uint32 i;
+    int result = 0;
+
+    for (i = 0; i < count; i ++) {
+        g_parse(g, parse[i], TRUE, FALSE);
+    }
+
+    resolver = corto_genDepBuild(g);
+    if (!resolver) {
+        ut_error("%s: failed to build dependency graph", test);
+        result = -1;
+    } else {
+        if (corto_genDepWalkResolver(g, resolver,
+            test_onPrintedDeclare, test_onPrintedDefine, printed))
+        {
+            ut_error("%s: failed to walk dependency graph", test);
+            result = -1;
+        }
+        corto_depresolver_free(resolver);
+    }
+
+    g_free(g);
+
+    return result;
+}
+
+/* Anonymous objects have no path, so they are ordered by type and value. The
+ * same anonymous types, found in a different order, are printed in the same
+ * order. */
+int test_genAnonymousOrder(void)
+{
+    corto_object scope, a, b, prev, parse[2][3];
+    corto_type listInt, listStr;
+    test_printed printed[2];
+    corto_uint32 i;
+    int result = 0;
+
+    memset(printed, 0, sizeof(printed));
+    listInt = corto_resolve(NULL, "list{int32}");
+    listStr = corto_resolve(NULL, "list{string}");
+    prev = test_markerBegin();
+    scope = corto_create(root_o, "test_anonymousOrder", corto_void_o);
+    a = corto_create(scope, "a", listInt);
+    b = corto_create(scope, "b", listStr);
+    test_markerEnd(prev);
+
+    parse[0][0] = scope; parse[0][1] = a; parse[0][2] = b;
+    parse[1][0] = scope; parse[1][1] = b; parse[1][2] = a;
+    for (i = 0; i < 2; i ++) {
+        if (test_genPrint("anonymousOrder", parse[i], 3, &printed[i])) {
+            result = -1;
+            goto cleanup;
+        }
+    }
+
+    if (!test_printedHas(&printed[0], listInt) ||
+        !test_printedHas(&printed[0], listStr))
+    {
+        ut_error("anonymousOrder: anonymous types are not printed");
+        result = -1;
+    } else {
+        result = test_printedCompare("anonymousOrder", &printed[0], &printed[1]);
+    }
+
+cleanup:
+    for (i = 0; i < 2; i ++) {
+        if (printed[i].objects) {
+            corto_dealloc(printed[i].objects);
+        }
+    }
+    corto_delete(scope);
+    corto_release(listInt);
+    corto_release(listStr);
+    return result;
+}
+
+/* Build dependency graph of objects and export it as JSON, so that graphs can
+ * be compared. Graphs are equal if they have the same items and the same
+ * dependencies in the same order. Objects are parsed with their scopes. The
+ * attribute is set if key is not NULL. Returns NULL if the graph cannot be
+ * built. */
+static
+char* test_genJson(
+    const char *test,
+    corto_object *parse,
+    corto_uint32 count,
+    char *key,
+    char *value)
+{
+    g_generator g = g_new("test", NULL);
+    corto_depresolver resolver;
+    corto_uint32 i;
+    char *result = NULL;
+
+    if (key) {
+        g_setAttribute(g, key, value);
+    }
+    for (i = 0; i < count; i ++) {
+        g_parse(g, parse[i], TRUE, TRUE);
+    }
+
+    resolver = corto_genDepBuild(g);
+    if (!resolver) {
+        ut_error("%s: failed to build dependency graph", test);
+    } else {
+        result = corto_depresolver_toJson(resolver);
+        corto_depresolver_free(resolver);
+    }
+
+    g_free(g);
+
+    return result;
+}
+
+/* Build graph with and without attribute. Returns the graph as JSON if both
+ * graphs are equal, otherwise NULL. */
+static
+char* test_genCompare(
+    const char *test,
+    corto_object *parse,
+    corto_uint32 count,
+    char *key,
+    char *value)
+{
+    char *json = test_genJson(test, parse, count, NULL, NULL);
+    char *jsonAttr = test_genJson(test, parse, count, key, value);
+
+    if (json && (!jsonAttr || strcmp(json, jsonAttr))) {
+        if (jsonAttr) {
+            ut_error("%s: graphs differ with %s=%s:\n%s\n%s",
+                test, key, value, json, jsonAttr);
+        }
+        corto_dealloc(json);
+        json = NULL;
+    }
+
+    if (jsonAttr) {
+        corto_dealloc(jsonAttr);
+    }
+
+    return json;
+}
+
+/* Find id of object in graph exported as JSON. Returns -1 if the object is
+ * not in the graph. */
+static
+corto_int32 test_jsonId(
+    const char *json,
+    corto_object o)
+{
+    corto_id id, item;
+    const char *ptr;
+
+    sprintf(item, ",\"name\":\"%s\",", corto_fullpath(id, o));
+    if (!(ptr = strstr(json, item))) {
+        return -1;
+    }
+
+    /* Items are exported as {"id":<id>,"name":<name>,...} */
+    while (ptr > json && ptr[-1] != ':') {
+        ptr --;
+    }
+
+    return atoi(ptr);
+}
+
+/* Test if graph exported as JSON has dependency */
+static
+corto_bool test_jsonDepends(
+    const char *json,
+    corto_object dependent,
+    corto_object dependency)
+{
+    corto_int32 from = test_jsonId(json, dependency);
+    corto_int32 to = test_jsonId(json, dependent);
+    corto_id edge, target;
+    const char *ptr = json;
+
+    if (from < 0 || to < 0) {
+        return FALSE;
+    }
+
+    sprintf(edge, "{\"dependency\":%d,", from);
+    sprintf(target, "\"dependent\":%d,", to);
+    while ((ptr = strstr(ptr, edge))) {
+        const char *end = strchr(ptr, '}'), *found = strstr(ptr, target);
+        if (found && found < end) {
+            return TRUE;
+        }
+        ptr = end;
+    }
+
+    return FALSE;
+}
+
+/* Check that object depends on targets in order of mask, where bit i is set
+ * if the object must depend on target i */
+static
+int test_jsonDependsMask(
+    const char *test,
+    const char *json,
+    corto_object o,
+    corto_object *targets,
+    corto_uint32 count,
+    corto_uint32 mask)
+{
+    corto_uint32 i;
+    int result = 0;
+
+    for (i = 0; i < count; i ++) {
+        corto_bool expect = (mask & (1 << i)) != 0;
+        if (test_jsonDepends(json, o, targets[i]) != expect) {
+            corto_id id;
+            ut_error("%s: dependency on '%s' is %s",
+                test,
+                corto_fullpath(id, targets[i]),
+                expect ? "not found" : "unexpected");
+            result = -1;
+        }
+    }
+
+    return result;
+}
+
+/* Layout of sequences */
+typedef struct test_seq {
+    corto_uint32 length;
+    void *buffer;
+} test_seq;
+
+/* Add member to type */
+static
+corto_member test_member(
+    corto_object type,
+    const char *name,
+    corto_type memberType,
+    corto_modifiers modifiers)
+{
+    corto_member m = corto_declare(type, name, corto_member_o);
+    corto_set_ref(&m->type, memberType);
+    m->modifiers = modifiers;
+    if (corto_define(m)) {
+        ut_error("failed to define member '%s': %s", name, ut_lasterr());
+    }
+    return m;
+}
+
+/* Add member with stateCondExpr to type */
+static
+corto_member test_condMember(
+    corto_object type,
+    const char *name,
+    corto_state state,
+    const char *expr)
+{
+    corto_member m = corto_declare(type, name, corto_member_o);
+    corto_set_ref(&m->type, corto_object_o);
+    m->state = state;
+    corto_set_str(&m->stateCondExpr, expr);
+    if (corto_define(m)) {
+        ut_error("failed to define member '%s': %s", name, ut_lasterr());
+    }
+    return m;
+}
+
+/* Add collection type */
+static
+corto_type test_collection(
+    corto_object scope,
+    const char *name,
+    corto_type kind,
+    corto_type elementType,
+    corto_uint32 max)
+{
+    corto_collection t = corto_declare(scope, name, kind);
+    corto_set_ref(&t->element_type, elementType);
+    t->max = max;
+    if (corto_define(t)) {
+        ut_error("failed to define type '%s': %s", name, ut_lasterr());
+    }
+    return corto_type(t);
+}
+
+/* Location of member in value */
+static
+void* test_field(
+    void *ptr,
+    corto_member m)
+{
+    return (char*)ptr + m->offset;
+}
+
+/* Create scope with objects that are referenced from test values */
+static
+corto_object test_targetsCreate(
+    const char *name,
+    corto_object *targets,
+    corto_uint32 count)
+{
+    corto_object scope = corto_create(root_o, name, corto_void_o);
+    corto_uint32 i;
+
+    for (i = 0; i < count; i ++) {
+        corto_id id;
+        sprintf(id, "t%u", i);
+        targets[i] = corto_create(scope, id, corto_void_o);
+    }
+
+    return scope;
+}
+
+#define TEST_REFS_TARGETS (11)
+
+/* Create scope with types whose values are described by reference tables, and
+ * an object that refers to targets through every kind of location:
+ *
+ *   class Base { ref: object }
+ *   struct Inner { ref: object; value: int32 }
+ *   class Derived: Base {
+ *     inner: Inner; arr: array{Inner, 2}; seq: sequence{Inner};
+ *     refs: array{object, 2}; local ref: object; flag: bool;
+ *     declared ref (if flag): object; valid ref (if flag): object
+ *   }
+ *
+ * Local members are not walked, so target 8 is not a dependency. */
+static
+corto_object test_refsCreate(
+    corto_object *targets)
+{
+    corto_object scope, prev, o;
+    corto_class base, derived;
+    corto_struct inner;
+    corto_type arr, seq, refs;
+    corto_member baseRef, innerRef, mInner, mArr, mSeq, mRefs, mLocal, mFlag;
+    corto_member mDeclared, mValid;
+    corto_uint32 i, size;
+    test_seq *seqValue;
+
+    prev = test_markerBegin();
+    scope = test_targetsCreate("test_refs", targets, TEST_REFS_TARGETS);
+
+    base = corto_declare(scope, "Base", corto_class_o);
+    baseRef = test_member(base, "ref", corto_object_o, 0);
+    corto_define(base);
+
+    inner = corto_declare(scope, "Inner", corto_struct_o);
+    innerRef = test_member(inner, "ref", corto_object_o, 0);
+    test_member(inner, "value", corto_int32_o, 0);
+    corto_define(inner);
+    size = corto_type_sizeof(corto_type(inner));
+
+    arr = test_collection(scope, "InnerArray", corto_array_o, corto_type(inner), 2);
+    seq = test_collection(scope, "InnerSeq", corto_sequence_o, corto_type(inner), 0);
+    refs = test_collection(
+        scope, "ObjectArray", corto_array_o, corto_object_o, 2);
+
+    derived = corto_declare(scope, "Derived", corto_class_o);
+    corto_set_ref(&corto_interface(derived)->base, base);
+    mInner = test_member(derived, "inner", corto_type(inner), 0);
+    mArr = test_member(derived, "arr", arr, 0);
+    mSeq = test_member(derived, "seq", seq, 0);
+    mRefs = test_member(derived, "refs", refs, 0);
+    mLocal = test_member(derived, "local", corto_object_o, CORTO_LOCAL);
+    mFlag = test_member(derived, "flag", corto_bool_o, 0);
+    mDeclared = test_condMember(derived, "declared", CORTO_DECLARED, "flag");
+    mValid = test_condMember(derived, "valid", CORTO_VALID, "flag");
+    corto_define(derived);
+
+    o = corto_declare(scope, "o", corto_type(derived));
+    corto_set_ref(test_field(o, baseRef), targets[0]);
+    corto_set_ref(test_field(test_field(o, mInner), innerRef), targets[1]);
+    for (i = 0; i < 2; i ++) {
+        void *elem = (char*)test_field(o, mArr) + i * size;
+        corto_set_ref(test_field(elem, innerRef), targets[2 + i]);
+    }
+    seqValue = test_field(o, mSeq);
+    seqValue->length = 2;
+    seqValue->buffer = corto_calloc(2 * size);
+    for (i = 0; i < 2; i ++) {
+        void *elem = (char*)seqValue->buffer + i * size;
+        corto_set_ref(test_field(elem, innerRef), targets[4 + i]);
+    }
+    for (i = 0; i < 2; i ++) {
+        corto_set_ref((corto_object*)test_field(o, mRefs) + i, targets[6 + i]);
+    }
+    corto_set_ref(test_field(o, mLocal), targets[8]);
+    *(corto_bool*)test_field(o, mFlag) = FALSE;
+    corto_set_ref(test_field(o, mDeclared), targets[9]);
+    corto_set_ref(test_field(o, mValid), targets[10]);
+    corto_define(o);
+
+    test_markerEnd(prev);
+
+    return scope;
+}
+
+/* Reference tables visit the same references in the same order as corto_walk,
+ * for base classes, nested structs, arrays and sequences of structs, local
+ * members and members with a stateCondExpr. */
+int test_genRefs(void)
+{
+    corto_object targets[TEST_REFS_TARGETS], scope, o;
+    char *json;
+    int result = -1;
+
+    scope = test_refsCreate(targets);
+    o = corto_lookup(scope, "o");
+
+    json = test_genCompare("refs", &scope, 1, "deprefs", "false");
+    if (json) {
+        result = test_jsonDependsMask("refs", json, o, targets,
+            TEST_REFS_TARGETS, 0x7ff & ~(1 << 8));
+        corto_dealloc(json);
+    }
+
+    corto_release(o);
+    corto_delete(scope);
+    return result;
+}
+
+#define TEST_FALLBACK_TARGETS (5)
+
+/* Create scope with types whose values cannot be described by reference
+ * tables, and an object that refers to targets through them:
+ *
+ *   union Choice: int32 { 1: ref: object }
+ *   struct Holder { refs: list{object} }
+ *   class Fallback {
+ *     opt: object (optional); obs: object (observable); choice: Choice;
+ *     holder: Holder; map: map{int32, object}
+ *   }
+ *
+ * The map is left empty, as its elements are managed by the map. */
+static
+corto_object test_fallbackCreate(
+    corto_object *targets)
+{
+    corto_object scope, prev, o;
+    corto_union choice;
+    corto_case choiceRef;
+    corto_struct holder;
+    corto_map map;
+    corto_class fallback;
+    corto_type list;
+    corto_member holderRefs, mOpt, mObs, mChoice, mHolder;
+    corto_object **ptr;
+    ut_ll *refs;
+    corto_uint32 i;
+
+    prev = test_markerBegin();
+    scope = test_targetsCreate("test_fallback", targets, TEST_FALLBACK_TARGETS);
+
+    choice = corto_declare(scope, "Choice", corto_union_o);
+    corto_set_ref(&choice->discriminator, corto_int32_o);
+    choiceRef = corto_declare(choice, "ref", corto_case_o);
+    corto_set_ref(&corto_member(choiceRef)->type, corto_object_o);
+    choiceRef->discriminator.length = 1;
+    choiceRef->discriminator.buffer = corto_alloc(sizeof(corto_int32));
+    choiceRef->discriminator.buffer[0] = 1;
+    corto_define(choiceRef);
+    corto_define(choice);
+
+    list = test_collection(scope, "ObjectList", corto_list_o, corto_object_o, 0);
+    holder = corto_declare(scope, "Holder", corto_struct_o);
+    holderRefs = test_member(holder, "refs", list, 0);
+    corto_define(holder);
+
+    map = corto_declare(scope, "ObjectMap", corto_map_o);
+    corto_set_ref(&map->key_type, corto_int32_o);
+    corto_set_ref(&corto_collection(map)->element_type, corto_object_o);
+    corto_define(map);
+
+    fallback = corto_declare(scope, "Fallback", corto_class_o);
+    mOpt = test_member(fallback, "opt", corto_object_o, CORTO_OPTIONAL);
+    mObs = test_member(fallback, "obs", corto_object_o, CORTO_OBSERVABLE);
+    mChoice = test_member(fallback, "choice", corto_type(choice), 0);
+    mHolder = test_member(fallback, "holder", corto_type(holder), 0);
+    test_member(fallback, "map", corto_type(map), 0);
+    corto_define(fallback);
+
+    o = corto_declare(scope, "o", corto_type(fallback));
+
+    /* Optional and observable members are stored as pointers */
+    ptr = test_field(o, mOpt);
+    if (!*ptr) {
+        *ptr = corto_calloc(sizeof(corto_object));
+    }
+    corto_set_ref(*ptr, targets[0]);
+    ptr = test_field(o, mObs);
+    if (!*ptr) {
+        *ptr = corto_calloc(sizeof(corto_object));
+    }
+    corto_set_ref(*ptr, targets[1]);
+
+    *(corto_int32*)test_field(o, mChoice) = 1;
+    corto_set_ref(test_field(test_field(o, mChoice), corto_member(choiceRef)),
+        targets[2]);
+
+    refs = test_field(test_field(o, mHolder), holderRefs);
+    if (!*refs) {
+        *refs = ut_ll_new();
+    }
+    for (i = 3; i < 5; i ++) {
+        corto_claim(targets[i]);
+        ut_ll_append(*refs, targets[i]);
+    }
+    corto_define(o);
+
+    test_markerEnd(prev);
+
+    return scope;
+}
+
+/* Values that reference tables cannot describe are walked with corto_walk,
+ * which visits the same references as when tables are disabled */
+int test_genRefsFallback(void)
+{
+    corto_object targets[TEST_FALLBACK_TARGETS], scope, o;
+    char *json;
+    int result = -1;
+
+    scope = test_fallbackCreate(targets);
+    o = corto_lookup(scope, "o");
+
+    json = test_genCompare("refsFallback", &scope, 1, "deprefs", "false");
+    if (json) {
+        result = test_jsonDependsMask("refsFallback", json, o, targets,
+            TEST_FALLBACK_TARGETS, 0x1f);
+        corto_dealloc(json);
+    }
+
+    corto_release(o);
+    corto_delete(scope);
+    return result;
+}
+
+/* Workers add the same items and dependencies in the same order as a serial
+ * build */
+int test_genWorkers(void)
+{
+    corto_object refsTargets[TEST_REFS_TARGETS];
+    corto_object fallbackTargets[TEST_FALLBACK_TARGETS];
+    corto_object scopes[2], refs, fallback;
+    char *json;
+    int result = -1;
+
+    scopes[0] = test_refsCreate(refsTargets);
+    scopes[1] = test_fallbackCreate(fallbackTargets);
+    refs = corto_lookup(scopes[0], "o");
+    fallback = corto_lookup(scopes[1], "o");
+
+    json = test_genCompare("genWorkers", scopes, 2, "depworkers", "4");
+    if (json) {
+        result = test_jsonDependsMask("genWorkers", json, refs, refsTargets,
+            TEST_REFS_TARGETS, 0x7ff & ~(1 << 8));
+        if (test_jsonDependsMask("genWorkers", json, fallback, fallbackTargets,
+            TEST_FALLBACK_TARGETS, 0x1f))
+        {
+            result = -1;
+        }
+        corto_dealloc(json);
+    }
+
+    corto_release(refs);
+    corto_release(fallback);
+    corto_delete(scopes[0]);
+    corto_delete(scopes[1]);
+    return result;
+}
+
+/* Create anonymous list type */
+static
+corto_type test_anonymousList(
+    corto_type elementType)
+{
+    corto_collection t = corto_declare(NULL, NULL, corto_list_o);
+    corto_set_ref(&t->element_type, elementType);
+    if (corto_define(t)) {
+        ut_error("failed to define anonymous list: %s", ut_lasterr());
+    }
+    return corto_type(t);
+}
+
+/* Anonymous objects with the same type and value are interned to the first of
+ * them, and share the number in their identifier */
+int test_genAnonymousIntern(void)
+{
+    corto_type l1 = test_anonymousList(corto_type(corto_int32_o));
+    corto_type l2 = test_anonymousList(corto_type(corto_int32_o));
+    corto_type l3 = test_anonymousList(corto_type(corto_string_o));
+    g_generator g = g_new("test", NULL);
+    corto_object scope;
+    corto_uint32 i1, i2, i3;
+    corto_id id1, id2, id3;
+    corto_int32 count1 = corto_countof(l1), count2 = corto_countof(l2);
+    int result = 0;
+
+    /* Identifiers of anonymous objects depend on the current object */
+    scope = corto_create(root_o, "test_anonymousIntern", corto_void_o);
+    g_parse(g, scope, TRUE, TRUE);
+
+    if (g_anonymousIntern(g, l1, &i1) != l1 ||
+        g_anonymousIntern(g, l2, &i2) != l1 ||
+        g_anonymousIntern(g, l3, &i3) != l3)
+    {
+        ut_error("anonymousIntern: objects are not interned by value");
+        result = -1;
+    } else if (i1 != i2 || i1 == i3) {
+        ut_error("anonymousIntern: index %u, %u and %u", i1, i2, i3);
+        result = -1;
+    }
+
+    /* The table claims interned objects, so their address is not reused */
+    if (corto_countof(l1) != count1 + 1 || corto_countof(l2) != count2 + 1) {
+        ut_error("anonymousIntern: interned objects are not claimed");
+        result = -1;
+    }
+
+    /* Numbers are assigned in order of first request */
+    g_fullOidExt(g, l2, id2, CORTO_GENERATOR_ID_DEFAULT);
+    g_fullOidExt(g, l3, id3, CORTO_GENERATOR_ID_DEFAULT);
+    g_fullOidExt(g, l1, id1, CORTO_GENERATOR_ID_DEFAULT);
+    if (strcmp(id1, id2) || !strcmp(id1, id3)) {
+        ut_error("anonymousIntern: identifiers '%s', '%s' and '%s'",
+            id1, id2, id3);
+        result = -1;
+    } else if (g_anonymousId(g, l1) != 0 || g_anonymousId(g, l3) != 1) {
+        ut_error("anonymousIntern: numbers %u and %u",
+            g_anonymousId(g, l1), g_anonymousId(g, l3));
+        result = -1;
+    }
+
+    g_free(g);
+    if (corto_countof(l1) != count1 || corto_countof(l2) != count2) {
+        ut_error("anonymousIntern: interned objects are not released");
+        result = -1;
+    }
+
+    corto_delete(scope);
+    corto_delete(l1);
+    corto_delete(l2);
+    corto_delete(l3);
+    return result;
+}
+
+/* Call of walk action */
+typedef struct test_walkCall {
+    corto_uint32 action;
+    corto_object o;
+} test_walkCall;
+
+/* Calls of walk actions, in order */
+typedef struct test_walkLog {
+    test_walkCall calls[64];
+    corto_uint32 count;
+} test_walkLog;
+
+/* Walk action that stops after limit calls, or never if limit is 0 */
+typedef struct test_walkAction {
+    test_walkLog *log;
+    corto_uint32 action;
+    corto_uint32 calls;
+    corto_uint32 limit;
+} test_walkAction;
+
+static
+int test_walkLogAction(
+    corto_object o,
+    void *userData)
+{
+    test_walkAction *action = userData;
+    test_walkLog *log = action->log;
+
+    if (log->count < 64) {
+        log->calls[log->count].action = action->action;
+        log->calls[log->count].o = o;
+        log->count ++;
+    }
+
+    action->calls ++;
+
+    return !action->limit || action->calls < action->limit;
+}
+
+/* Run two actions with g_walkMulti, and check calls against objects walked by
+ * g_walkRecursive. Action 0 stops after limit calls. */
+static
+int test_walkMultiCheck(
+    g_generator g,
+    corto_uint32 flags,
+    corto_uint32 limit)
+{
+    test_walkLog expect, log;
+    test_walkAction walk = {&expect, 0, 0, 0};
+    test_walkAction actions[2] = {{&log, 0, 0, limit}, {&log, 1, 0, 0}};
+    g_walkAction walkActions[2] = {test_walkLogAction, test_walkLogAction};
+    void *walkData[2] = {&actions[0], &actions[1]};
+    corto_uint32 i, first = 0, second = 0, count, stop;
+    int ret;
+
+    expect.count = 0;
+    log.count = 0;
+    g_walkRecursive(g, test_walkLogAction, &walk);
+    count = expect.count;
+    stop = limit && limit < count ? limit : count;
+
+    ret = g_walkMulti(g, walkActions, walkData, 2, G_WALK_RECURSIVE | flags);
+    if (ret != (stop == count)) {
+        ut_error("walkMulti: returned %d", ret);
+        return -1;
+    }
+
+    if (log.count != stop + count) {
+        ut_error("walkMulti: %u calls for %u objects", log.count, count);
+        return -1;
+    }
+
+    /* Without phases both actions run on an object before the next object */
+    for (i = 0; i < log.count; i ++) {
+        test_walkCall *call = &log.calls[i];
+        corto_uint32 expectAction;
+
+        if (flags & G_WALK_PHASES) {
+            expectAction = i >= stop;
+        } else if (i < 2 * stop) {
+            expectAction = i % 2;
+        } else {
+            expectAction = 1;
+        }
+
+        if (call->action != expectAction) {
+            ut_error("walkMulti: call %u is of action %u", i, call->action);
+            return -1;
+        }
+
+        if (call->o != expect.calls[call->action ? second : first].o) {
+            ut_error("walkMulti: call %u is on wrong object", i);
+            return -1;
+        }
+
+        if (call->action) {
+            second ++;
+        } else {
+            first ++;
+        }
+    }
+
+    return 0;
+}
+
+/* Actions of g_walkMulti are called on objects in the order of g_walkRecursive,
+ * either object by object or action by action. An action that stops does not
+ * stop other actions. */
+int test_genWalkMulti(void)
+{
+    g_generator g = g_new("test", NULL);
+    corto_object scope, nested, prev;
+    corto_uint32 i;
+    int result = 0;
+
+    prev = test_markerBegin();
+    scope = corto_create(root_o, "test_walkMulti", corto_void_o);
+    for (i = 0; i < 4; i ++) {
+        corto_id id;
+        sprintf(id, "o%u", i);
+        nested = corto_create(scope, id, corto_void_o);
+        corto_create(nested, "child", corto_int32_o);
+    }
+    test_markerEnd(prev);
+    g_parse(g, scope, TRUE, TRUE);
+
+    if (test_walkMultiCheck(g, 0, 0) ||
+        test_walkMultiCheck(g, G_WALK_PHASES, 0) ||
+        test_walkMultiCheck(g, 0, 3) ||
+        test_walkMultiCheck(g, G_WALK_PHASES, 3))
+    {
+        result = -1;
+    }
+
+    g_free(g);
+    corto_delete(scope);
+    return result;
+}
+
+/* g_walkAll replays the order of its first walk to later walks, so objects
+ * created after the first walk are not walked until the order is forgotten.
+ * Setting the "bootstrap" attribute and parsing objects forget the order. */
+int test_genWalkAll(void)
+{
+    g_generator g = g_new("test", NULL);
+    corto_object scope, other, a, b, c, d, e, prev;
+    test_printed printed[5];
+    corto_uint32 i;
+    int result = -1;
+
+    memset(printed, 0, sizeof(printed));
+    prev = test_markerBegin();
+    scope = corto_create(root_o, "test_walkAll", corto_void_o);
+    other = corto_create(root_o, "test_walkAllOther", corto_void_o);
+    a = corto_create(scope, "a", corto_int32_o);
+    b = corto_create(scope, "b", corto_int32_o);
+    g_parse(g, scope, TRUE, TRUE);
+
+    g_walkAll(g, test_onPrintedDefine, &printed[0]);
+    if (!test_printedHas(&printed[0], a) || !test_printedHas(&printed[0], b)) {
+        ut_error("walkAll: objects are not walked");
+        goto cleanup;
+    }
+
+    /* A second driver replays the order */
+    c = corto_create(scope, "c", corto_int32_o);
+    g_walkAll(g, test_onPrintedDefine, &printed[1]);
+    if (test_printedCompare("walkAll", &printed[0], &printed[1])) {
+        goto cleanup;
+    }
+
+    g_setAttribute(g, "bootstrap", "false");
+    g_walkAll(g, test_onPrintedDefine, &printed[2]);
+    if (!test_printedHas(&printed[2], c)) {
+        ut_error("walkAll: order is not forgotten when bootstrap is set");
+        goto cleanup;
+    }
+
+    d = corto_create(scope, "d", corto_int32_o);
+    e = corto_create(other, "e", corto_int32_o);
+    g_walkAll(g, test_onPrintedDefine, &printed[3]);
+    if (test_printedCompare("walkAll", &printed[2], &printed[3])) {
+        goto cleanup;
+    }
+
+    g_parse(g, other, TRUE, TRUE);
+    g_walkAll(g, test_onPrintedDefine, &printed[4]);
+    if (!test_printedHas(&printed[4], d) || !test_printedHas(&printed[4], e)) {
+        ut_error("walkAll: order is not forgotten when objects are parsed");
+        goto cleanup;
+    }
+
+    result = 0;
+cleanup:
+    test_markerEnd(prev);
+    for (i = 0; i < 5; i ++) {
+        if (printed[i].objects) {
+            corto_dealloc(printed[i].objects);
+        }
+    }
+    g_free(g);
+    corto_delete(scope);
+    corto_delete(other);
+    return result;
+}
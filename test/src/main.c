@@ -0,0 +1,1378 @@
+/* Copyright (c) 2010-2018 the corto developers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* Regression tests for the dependency resolver. Every test builds graphs of
+ * plain memory cells, walks them and verifies the printed order:
+ *
+ *   test [test]
+ *
+ * Every item must be declared before it is defined, and printed after the
+ * items it depends on. A weak dependency (on DECLARED | VALID) may be broken,
+ * but only after its dependency is declared. Tests of the dependency walk of
+ * generators are in generator.c. */
+
+#include <corto.g.test>
+
+#define TEST_SEEDS (16)
+
+/* Dependency in a test graph, by item index */
+typedef struct test_edge {
+    corto_uint32 dependent;
+    corto_state kind;
+    corto_uint32 dependency;
+    corto_state dependencyKind;
+} test_edge;
+
+/* Graph and printed order. Positions are increasing over all walks of a
+ * graph, so that items printed by an update can be checked against items
+ * printed by earlier walks. */
+typedef struct test_graph {
+    corto_uint64 *items;
+    corto_uint32 count;
+    test_edge *edges;
+    corto_uint32 edgeCount;
+    corto_uint32 edgeSize;
+    corto_uint32 *declared; /* Position of last declare, 0 if not printed */
+    corto_uint32 *defined; /* Position of last define, 0 if not printed */
+    corto_uint32 *walked; /* Walk in which item was last printed */
+    corto_uint32 walk;
+    corto_uint32 position;
+    corto_uint32 errors;
+    struct ut_mutex_s lock;
+} test_graph;
+
+typedef int (*test_action)(void);
+
+typedef struct test_case {
+    const char *name;
+    test_action run;
+} test_case;
+
+static unsigned int test_seed;
+
+/* Deterministic random numbers, so that failures can be reproduced */
+static
+corto_uint32 test_random(void)
+{
+    test_seed = test_seed * 1103515245 + 12345;
+    return (test_seed >> 16) & 0x7fff;
+}
+
+static
+void test_graphInit(
+    test_graph *graph,
+    corto_uint32 count)
+{
+    memset(graph, 0, sizeof(test_graph));
+    graph->items = corto_calloc(count * sizeof(corto_uint64));
+    graph->declared = corto_calloc(count * sizeof(corto_uint32));
+    graph->defined = corto_calloc(count * sizeof(corto_uint32));
+    graph->walked = corto_calloc(count * sizeof(corto_uint32));
+    graph->count = count;
+    ut_mutex_new(&graph->lock);
+}
+
+static
+void test_graphDeinit(
+    test_graph *graph)
+{
+    corto_dealloc(graph->items);
+    corto_dealloc(graph->declared);
+    corto_dealloc(graph->defined);
+    corto_dealloc(graph->walked);
+    if (graph->edges) {
+        corto_dealloc(graph->edges);
+    }
+    ut_mutex_free(&graph->lock);
+}
+
+static
+corto_uint32 test_index(
+    test_graph *graph,
+    void *item)
+{
+    return (corto_uint32)((corto_uint64*)item - graph->items);
+}
+
+static
+char* test_name(
+    void *item,
+    void *keyData)
+{
+    return ut_asprintf("item%u", test_index(keyData, item));
+}
+
+/* Record declare or define of item. Callbacks may be invoked from multiple
+ * threads. */
+static
+int test_print(
+    test_graph *graph,
+    void *item,
+    corto_bool define)
+{
+    corto_uint32 i = test_index(graph, item);
+
+    ut_mutex_lock(&graph->lock);
+    if (!define) {
+        if (graph->walked[i] == graph->walk && graph->declared[i]) {
+            ut_error("item%u declared twice", i);
+            graph->errors ++;
+        }
+        graph->walked[i] = graph->walk;
+        graph->declared[i] = ++ graph->position;
+        graph->defined[i] = 0;
+    } else {
+        if (graph->walked[i] != graph->walk || !graph->declared[i]) {
+            ut_error("item%u defined before it is declared", i);
+            graph->errors ++;
+        } else if (graph->defined[i]) {
+            ut_error("item%u defined twice", i);
+            graph->errors ++;
+        }
+        graph->defined[i] = ++ graph->position;
+    }
+    ut_mutex_unlock(&graph->lock);
+
+    return 1;
+}
+
+static
+int test_onDeclare(
+    corto_object o,
+    void *userData)
+{
+    return test_print(userData, o, FALSE);
+}
+
+static
+int test_onDefine(
+    corto_object o,
+    void *userData)
+{
+    return test_print(userData, o, TRUE);
+}
+
+/* Create resolver for graph. Items are not objects, so the resolver is created
+ * for generic items. */
+static
+corto_depresolver test_create(
+    test_graph *graph,
+    corto_uint32 flags,
+    corto_uint32 workers,
+    void *root)
+{
+    corto_depresolver_opt opt;
+
+    corto_depresolver_opt_init(&opt);
+    opt.onDeclare = test_onDeclare;
+    opt.onDefine = test_onDefine;
+    opt.userData = graph;
+    opt.flags = flags;
+    opt.workers = workers;
+    opt.name = test_name;
+    opt.keyData = graph;
+    opt.root = root;
+
+    return corto_depresolverCreateGeneric(&opt);
+}
+
+/* Add dependency to graph and resolver */
+static
+void test_depend(
+    test_graph *graph,
+    corto_depresolver resolver,
+    corto_uint32 dependent,
+    corto_state kind,
+    corto_uint32 dependency,
+    corto_state dependencyKind)
+{
+    test_edge *edge;
+
+    if (graph->edgeCount == graph->edgeSize) {
+        graph->edgeSize = graph->edgeSize ? graph->edgeSize * 2 : 64;
+        graph->edges = corto_realloc(
+            graph->edges, graph->edgeSize * sizeof(test_edge));
+    }
+
+    edge = &graph->edges[graph->edgeCount ++];
+    edge->dependent = dependent;
+    edge->kind = kind;
+    edge->dependency = dependency;
+    edge->dependencyKind = dependencyKind;
+
+    corto_depresolver_depend(resolver,
+        &graph->items[dependent], kind, &graph->items[dependency],
+        dependencyKind);
+}
+
+/* Remove dependency from graph and resolver */
+static
+void test_undepend(
+    test_graph *graph,
+    corto_depresolver resolver,
+    corto_uint32 index)
+{
+    test_edge edge = graph->edges[index];
+    corto_uint32 i = 0;
+
+    corto_depresolver_undepend(resolver,
+        &graph->items[edge.dependent], edge.kind,
+        &graph->items[edge.dependency], edge.dependencyKind);
+
+    /* The resolver does not store duplicate dependencies */
+    while (i < graph->edgeCount) {
+        test_edge *e = &graph->edges[i];
+        if (e->dependent == edge.dependent && e->kind == edge.kind &&
+            e->dependency == edge.dependency &&
+            e->dependencyKind == edge.dependencyKind)
+        {
+            *e = graph->edges[-- graph->edgeCount];
+        } else {
+            i ++;
+        }
+    }
+}
+
+/* Random dependencies that can be resolved. Dependencies that cannot be
+ * broken only go from items to items with a lower index, and declares only
+ * depend on declares. Weak dependencies go in any direction and form cycles,
+ * which can always be broken by declaring all items before defining them. */
+static
+void test_randomEdges(
+    test_graph *graph,
+    corto_depresolver resolver,
+    corto_uint32 edges)
+{
+    corto_uint32 i;
+
+    for (i = 0; i < edges; i ++) {
+        corto_uint32 a = test_random() % graph->count;
+        corto_uint32 b = test_random() % graph->count;
+        corto_uint32 kind = test_random() % 4;
+
+        if (a == b) {
+            continue;
+        }
+
+        if (kind == 0) {
+            test_depend(graph, resolver,
+                a, CORTO_VALID, b, CORTO_DECLARED | CORTO_VALID);
+        } else {
+            corto_uint32 lo = a < b ? a : b, hi = a < b ? b : a;
+            if (kind == 1) {
+                test_depend(graph, resolver,
+                    hi, CORTO_DECLARED, lo, CORTO_DECLARED);
+            } else {
+                test_depend(graph, resolver,
+                    hi, CORTO_VALID,
+                    lo, test_random() % 2 ? CORTO_DECLARED : CORTO_VALID);
+            }
+        }
+    }
+}
+
+/* Random graph that can be resolved */
+static
+void test_randomGraph(
+    test_graph *graph,
+    corto_depresolver resolver,
+    corto_uint32 edges)
+{
+    corto_uint32 i;
+
+    for (i = 0; i < graph->count; i ++) {
+        corto_depresolver_insert(resolver, &graph->items[i]);
+    }
+
+    test_randomEdges(graph, resolver, edges);
+}
+
+/* Verify that all items except root are printed, and that the printed order
+ * respects all dependencies of the graph. */
+static
+int test_check(
+    test_graph *graph,
+    const char *test,
+    corto_int32 root)
+{
+    corto_uint32 i, errors = graph->errors;
+
+    for (i = 0; i < graph->count; i ++) {
+        if ((corto_int32)i == root) {
+            continue;
+        }
+        if (!graph->declared[i] || !graph->defined[i]) {
+            ut_error("%s: item%u is not printed", test, i);
+            errors ++;
+        }
+    }
+
+    for (i = 0; i < graph->edgeCount; i ++) {
+        test_edge *edge = &graph->edges[i];
+        corto_uint32 dependent, dependency;
+
+        if ((corto_int32)edge->dependent == root ||
+            (corto_int32)edge->dependency == root)
+        {
+            continue;
+        }
+
+        dependent = edge->kind == CORTO_DECLARED
+            ? graph->declared[edge->dependent]
+            : graph->defined[edge->dependent];
+        dependency = edge->dependencyKind == CORTO_DECLARED
+            ? graph->declared[edge->dependency]
+            : graph->defined[edge->dependency];
+
+        /* A broken weak dependency only requires a declaration */
+        if (edge->dependencyKind == (CORTO_DECLARED | CORTO_VALID) &&
+            dependency > dependent)
+        {
+            dependency = graph->declared[edge->dependency];
+        }
+
+        if (dependency > dependent) {
+            ut_error("%s: item%u %s before item%u is %s", test,
+                edge->dependent,
+                edge->kind == CORTO_DECLARED ? "declared" : "defined",
+                edge->dependency,
+                edge->dependencyKind == CORTO_DECLARED ? "declared" : "defined");
+            errors ++;
+        }
+    }
+
+    return errors ? -1 : 0;
+}
+
+/* Walk graph and verify printed order */
+static
+int test_walk(
+    test_graph *graph,
+    corto_depresolver resolver,
+    const char *test,
+    corto_int32 root)
+{
+    graph->walk ++;
+    if (corto_depresolver_walk(resolver)) {
+        ut_error("%s: walk failed", test);
+        return -1;
+    }
+
+    return test_check(graph, test, root);
+}
+
+/* Walk random graphs with cycles with flags and workers */
+static
+int test_cycles(
+    const char *test,
+    corto_uint32 flags,
+    corto_uint32 workers)
+{
+    corto_uint32 seed;
+    int result = 0;
+
+    for (seed = 1; seed <= TEST_SEEDS && !result; seed ++) {
+        corto_uint32 count = 10 + seed * 40;
+        corto_depresolver resolver;
+        test_graph graph;
+
+        test_seed = seed;
+        test_graphInit(&graph, count);
+        resolver = test_create(&graph, flags, workers, NULL);
+        test_randomGraph(&graph, resolver, count * 3);
+        result = test_walk(&graph, resolver, test, -1);
+        corto_depresolver_free(resolver);
+        test_graphDeinit(&graph);
+    }
+
+    return result;
+}
+
+static
+int test_cyclesPlain(void)
+{
+    return test_cycles("cycles", 0, 0);
+}
+
+static
+int test_cyclesOrdered(void)
+{
+    return test_cycles("orderedCycles", CORTO_DEPRESOLVER_ORDERED, 0);
+}
+
+static
+int test_cyclesMinimal(void)
+{
+    return test_cycles("minimalCycles", CORTO_DEPRESOLVER_MINIMAL_BREAK, 0);
+}
+
+static
+int test_cyclesOrderedMinimal(void)
+{
+    return test_cycles(
+        "orderedMinimalCycles",
+        CORTO_DEPRESOLVER_ORDERED | CORTO_DEPRESOLVER_MINIMAL_BREAK,
+        0);
+}
+
+/* Items are printed by a pool of workers. Callbacks may run at the same time,
+ * but items must still be printed after their dependencies. */
+static
+int test_cyclesWorkers(void)
+{
+    return test_cycles("workers", CORTO_DEPRESOLVER_THREADSAFE, 4);
+}
+
+/* Walk graph and verify that every item is printed again */
+static
+int test_rewalk(
+    test_graph *graph,
+    corto_depresolver resolver,
+    const char *test)
+{
+    corto_uint32 i;
+
+    if (test_walk(graph, resolver, test, -1)) {
+        return -1;
+    }
+
+    for (i = 0; i < graph->count; i ++) {
+        if (graph->walked[i] != graph->walk) {
+            ut_error("%s: item%u is not printed again", test, i);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/* A frozen graph can be walked more than once, and is frozen again when
+ * dependencies are added after a walk. */
+static
+int test_refreeze(void)
+{
+    corto_uint32 flags[] = {0, CORTO_DEPRESOLVER_ORDERED};
+    corto_uint32 seed, f;
+    int result = 0;
+
+    for (f = 0; f < 2 && !result; f ++) {
+        for (seed = 1; seed <= TEST_SEEDS && !result; seed += 3) {
+            corto_uint32 count = 10 + seed * 40;
+            corto_depresolver resolver;
+            test_graph graph;
+
+            test_seed = seed;
+            test_graphInit(&graph, count);
+            resolver = test_create(&graph, flags[f], 0, NULL);
+            test_randomGraph(&graph, resolver, count * 2);
+
+            corto_depresolver_freeze(resolver);
+            result = test_rewalk(&graph, resolver, "refreeze");
+            if (!result) {
+                result = test_rewalk(&graph, resolver, "refreeze");
+            }
+            if (!result) {
+                test_randomEdges(&graph, resolver, count);
+                result = test_rewalk(&graph, resolver, "refreeze");
+            }
+
+            corto_depresolver_free(resolver);
+            test_graphDeinit(&graph);
+        }
+    }
+
+    return result;
+}
+
+/* Verify that an update printed item */
+static
+int test_updated(
+    test_graph *graph,
+    corto_uint32 item)
+{
+    if (graph->walked[item] != graph->walk) {
+        ut_error("update: item%u changed but is not printed", item);
+        return -1;
+    }
+    return 0;
+}
+
+/* Update graph after inserting items, adding and removing dependencies and
+ * removing an item. Items printed by the update must be printed after items
+ * printed by the first walk that they depend on, so an item that depends on
+ * a changed item must be printed again. */
+static
+int test_updateGraph(
+    corto_uint32 flags,
+    corto_uint32 workers)
+{
+    corto_uint32 seed;
+    int result = 0;
+
+    for (seed = 1; seed <= TEST_SEEDS && !result; seed += 3) {
+        corto_uint32 count = 10 + seed * 40, first = count * 3 / 4;
+        corto_uint32 removed, i, edgeCount;
+        corto_bool *changed = corto_calloc(count * sizeof(corto_bool));
+        corto_depresolver resolver;
+        test_graph graph;
+
+        test_seed = seed;
+        test_graphInit(&graph, count);
+        resolver = test_create(&graph, flags, workers, NULL);
+
+        /* Walk graph with the first items */
+        graph.count = first;
+        test_randomGraph(&graph, resolver, first * 2);
+        result = test_walk(&graph, resolver, "update", -1);
+        graph.count = count;
+        if (result) {
+            goto done;
+        }
+
+        /* Insert remaining items, with dependencies between all items */
+        for (i = first; i < count; i ++) {
+            corto_depresolver_insert(resolver, &graph.items[i]);
+            changed[i] = TRUE;
+        }
+        edgeCount = graph.edgeCount;
+        test_randomEdges(&graph, resolver, count / 2);
+        for (i = edgeCount; i < graph.edgeCount; i ++) {
+            changed[graph.edges[i].dependent] = TRUE;
+        }
+
+        /* Remove dependencies of the first walk */
+        for (i = 0; i < count / 8 && edgeCount; i ++) {
+            corto_uint32 e = test_random() % edgeCount;
+            changed[graph.edges[e].dependent] = TRUE;
+            test_undepend(&graph, resolver, e);
+            if (edgeCount > graph.edgeCount) {
+                edgeCount = graph.edgeCount;
+            }
+        }
+
+        /* Items that depended on a removed item change */
+        removed = test_random() % first;
+        for (i = 0; i < graph.edgeCount; i ++) {
+            if (graph.edges[i].dependency == removed &&
+                graph.edges[i].dependent != removed)
+            {
+                changed[graph.edges[i].dependent] = TRUE;
+            }
+        }
+        corto_depresolver_remove(resolver, &graph.items[removed]);
+
+        graph.walk ++;
+        if (corto_depresolver_update(resolver)) {
+            ut_error("update: update failed");
+            result = -1;
+            goto done;
+        }
+
+        result = test_check(&graph, "update", removed);
+        for (i = 0; i < count && !result; i ++) {
+            if (changed[i] && i != removed) {
+                result = test_updated(&graph, i);
+            }
+        }
+
+done:
+        corto_depresolver_free(resolver);
+        test_graphDeinit(&graph);
+        corto_dealloc(changed);
+    }
+
+    return result;
+}
+
+static
+int test_update(void)
+{
+    return test_updateGraph(0, 0);
+}
+
+static
+int test_updateOrdered(void)
+{
+    return test_updateGraph(CORTO_DEPRESOLVER_ORDERED, 0);
+}
+
+static
+int test_updateWorkers(void)
+{
+    return test_updateGraph(CORTO_DEPRESOLVER_THREADSAFE, 4);
+}
+
+#define TEST_FILE "test_depresolver.graph"
+#define TEST_KEY (0x5eed)
+
+/* Find item of graph by name. Items past count cannot be found. */
+static
+void* test_lookup(
+    const char *name,
+    void *userData)
+{
+    test_graph *graph = userData;
+    unsigned int i;
+
+    if (sscanf(name, "item%u", &i) != 1 || i >= graph->count) {
+        return NULL;
+    }
+
+    return &graph->items[i];
+}
+
+/* Load graph stored with save in a new resolver */
+static
+int test_load(
+    test_graph *graph,
+    corto_uint32 flags,
+    corto_uint64 key,
+    corto_depresolver *resolver)
+{
+    *resolver = test_create(graph, flags, 0, NULL);
+    return corto_depresolver_load(
+        *resolver, TEST_FILE, key, test_lookup, graph);
+}
+
+/* A saved graph is loaded with the same dependencies, so that a walk of the
+ * loaded graph prints items in a valid order. A graph is not loaded when
+ * the key does not match, or when an item cannot be found. */
+static
+int test_saveLoad(void)
+{
+    corto_uint32 flags[] = {0, CORTO_DEPRESOLVER_REDUCE};
+    corto_uint32 seed, f;
+    int result = 0;
+
+    for (f = 0; f < 2 && !result; f ++) {
+        for (seed = 1; seed <= TEST_SEEDS && !result; seed += 3) {
+            corto_uint32 count = 10 + seed * 40;
+            corto_depresolver resolver, loaded = NULL;
+            test_graph graph;
+
+            test_seed = seed;
+            test_graphInit(&graph, count);
+            resolver = test_create(&graph, flags[f], 0, NULL);
+            test_randomGraph(&graph, resolver, count * 3);
+
+            if ((result = test_walk(&graph, resolver, "saveLoad", -1))) {
+                goto done;
+            }
+
+            if (corto_depresolver_save(
+                resolver, TEST_FILE, TEST_KEY, test_name, &graph))
+            {
+                ut_error("saveLoad: failed to save graph");
+                result = -1;
+                goto done;
+            }
+
+            if (test_load(&graph, flags[f], TEST_KEY, &loaded)) {
+                ut_error("saveLoad: failed to load graph");
+                result = -1;
+                goto done;
+            }
+            if ((result = test_rewalk(&graph, loaded, "saveLoad"))) {
+                goto done;
+            }
+            corto_depresolver_free(loaded);
+
+            if (test_load(&graph, flags[f], TEST_KEY + 1, &loaded) != 1) {
+                ut_error("saveLoad: graph loaded with another key");
+                result = -1;
+                goto done;
+            }
+            corto_depresolver_free(loaded);
+
+            graph.count --;
+            if (test_load(&graph, flags[f], TEST_KEY, &loaded) != -1) {
+                ut_error("saveLoad: graph loaded with missing item");
+                result = -1;
+            } else {
+                ut_catch();
+            }
+            graph.count ++;
+
+done:
+            if (loaded) {
+                corto_depresolver_free(loaded);
+            }
+            corto_depresolver_free(resolver);
+            test_graphDeinit(&graph);
+            remove(TEST_FILE);
+        }
+    }
+
+    return result;
+}
+
+/* Scope hierarchy as deep as there are items, where each item has a weak
+ * dependency on its parent. All items are in one component, which requires
+ * breaking a dependency for every level. */
+static
+int test_deepCycle(void)
+{
+    corto_uint32 count = 2000, i;
+    corto_depresolver resolver;
+    corto_depresolver_stats_t stats;
+    test_graph graph;
+    int result;
+
+    test_graphInit(&graph, count);
+    resolver = test_create(&graph, 0, 0, NULL);
+    for (i = 1; i < count; i ++) {
+        test_depend(&graph, resolver, i, CORTO_DECLARED, i - 1, CORTO_DECLARED);
+        test_depend(&graph, resolver, i - 1, CORTO_VALID, i, CORTO_VALID);
+        test_depend(&graph, resolver,
+            i, CORTO_VALID, i - 1, CORTO_DECLARED | CORTO_VALID);
+    }
+    test_depend(&graph, resolver,
+        count - 1, CORTO_VALID, 0, CORTO_DECLARED | CORTO_VALID);
+
+    result = test_walk(&graph, resolver, "deepCycle", -1);
+
+    corto_depresolver_stats(resolver, &stats);
+    if (!result && (stats.sccCount != 1 || stats.sccItems != count ||
+        !stats.brokenEdges))
+    {
+        ut_error("deepCycle: found %u components with %u items, broke %u "
+            "dependencies", stats.sccCount, stats.sccItems, stats.brokenEdges);
+        result = -1;
+    }
+
+    corto_depresolver_free(resolver);
+    test_graphDeinit(&graph);
+
+    return result;
+}
+
+/* A cycle without weak dependencies cannot be broken. The walk fails without
+ * defining the items in the cycle, and still prints the items that do not
+ * depend on the cycle. */
+static
+int test_unresolvable(void)
+{
+    corto_depresolver resolver;
+    test_graph graph;
+    int result = 0;
+
+    test_graphInit(&graph, 3);
+    resolver = test_create(&graph, 0, 0, NULL);
+    corto_depresolver_insert(resolver, &graph.items[2]);
+    test_depend(&graph, resolver, 0, CORTO_VALID, 1, CORTO_VALID);
+    test_depend(&graph, resolver, 1, CORTO_VALID, 0, CORTO_VALID);
+
+    graph.walk ++;
+    if (!corto_depresolver_walk(resolver)) {
+        ut_error("unresolvable: walk succeeded");
+        result = -1;
+    }
+    ut_catch();
+
+    if (graph.defined[0] || graph.defined[1]) {
+        ut_error("unresolvable: item in cycle is defined");
+        result = -1;
+    }
+    if (!graph.declared[0] || !graph.declared[1] || !graph.defined[2]) {
+        ut_error("unresolvable: items are not printed");
+        result = -1;
+    }
+    if (graph.errors) {
+        result = -1;
+    }
+
+    corto_depresolver_free(resolver);
+    test_graphDeinit(&graph);
+
+    return result;
+}
+
+static
+int test_reduce(void)
+{
+    return test_cycles("reduce", CORTO_DEPRESOLVER_REDUCE, 0);
+}
+
+/* A dependency that is implied by a path through the root item must not be
+ * removed, as the walk resolves dependencies of the root before anything is
+ * printed. Item 1 is defined after item 2 through the root (item 0) and by a
+ * direct dependency. Item 1 is added first, so it would be printed first if
+ * the direct dependency were removed. */
+static
+int test_reduceRoot(void)
+{
+    corto_depresolver resolver;
+    corto_depresolver_stats_t stats;
+    test_graph graph;
+    int result = 0;
+
+    test_graphInit(&graph, 3);
+    resolver = test_create(&graph,
+        CORTO_DEPRESOLVER_REDUCE | CORTO_DEPRESOLVER_ORDERED, 0,
+        &graph.items[0]);
+
+    corto_depresolver_insert(resolver, &graph.items[1]);
+    corto_depresolver_insert(resolver, &graph.items[2]);
+    test_depend(&graph, resolver, 1, CORTO_VALID, 0, CORTO_VALID);
+    test_depend(&graph, resolver, 0, CORTO_VALID, 2, CORTO_VALID);
+    test_depend(&graph, resolver, 1, CORTO_VALID, 2, CORTO_VALID);
+
+    result = test_walk(&graph, resolver, "reduceRoot", 0);
+    if (!result && graph.declared[0]) {
+        ut_error("reduceRoot: root is printed");
+        result = -1;
+    }
+
+    corto_depresolver_stats(resolver, &stats);
+    if (stats.reducedEdges) {
+        ut_error("reduceRoot: removed %u dependencies through root",
+            stats.reducedEdges);
+        result = -1;
+    }
+
+    corto_depresolver_free(resolver);
+    test_graphDeinit(&graph);
+
+    return result;
+}
+
+/* Dependencies implied by a chain of dependencies are removed */
+static
+int test_reduceChain(void)
+{
+    corto_depresolver resolver;
+    corto_depresolver_stats_t stats;
+    test_graph graph;
+    int result = 0;
+
+    test_graphInit(&graph, 3);
+    resolver = test_create(&graph, CORTO_DEPRESOLVER_REDUCE, 0, NULL);
+    test_depend(&graph, resolver, 1, CORTO_DECLARED, 0, CORTO_VALID);
+    test_depend(&graph, resolver, 2, CORTO_DECLARED, 1, CORTO_VALID);
+    test_depend(&graph, resolver, 2, CORTO_DECLARED, 0, CORTO_VALID);
+
+    result = test_walk(&graph, resolver, "reduceChain", -1);
+
+    corto_depresolver_stats(resolver, &stats);
+    if (stats.reducedEdges != 1) {
+        ut_error("reduceChain: removed %u dependencies, expected 1",
+            stats.reducedEdges);
+        result = -1;
+    }
+
+    corto_depresolver_free(resolver);
+    test_graphDeinit(&graph);
+
+    return result;
+}
+
+/* Order in which items are defined */
+typedef struct test_order {
+    corto_uint64 *items;
+    corto_uint32 *defined;
+    corto_uint32 count;
+} test_order;
+
+static
+int test_onOrderDeclare(
+    corto_object o,
+    void *userData)
+{
+    CORTO_UNUSED(o);
+    CORTO_UNUSED(userData);
+    return 1;
+}
+
+static
+int test_onOrderDefine(
+    corto_object o,
+    void *userData)
+{
+    test_order *order = userData;
+    order->defined[order->count ++] =
+        (corto_uint32)((corto_uint64*)o - order->items);
+    return 1;
+}
+
+/* Rank of items for ordering */
+typedef struct test_rank {
+    corto_uint64 *items;
+    corto_uint32 *rank;
+} test_rank;
+
+/* Print items by rank. Ranks are found through keyData. */
+static
+int test_compareRank(
+    corto_object o1,
+    corto_object o2,
+    void *userData)
+{
+    test_rank *rank = userData;
+    corto_uint32 r1 = rank->rank[(corto_uint64*)o1 - rank->items];
+    corto_uint32 r2 = rank->rank[(corto_uint64*)o2 - rank->items];
+    return r1 < r2 ? -1 : r1 > r2;
+}
+
+/* The compare function receives keyData, so the order does not change when
+ * the actions and their userData are replaced. Item i has rank 3 * i modulo 8,
+ * so the item with rank k is item 3 * k modulo 8. */
+static
+int test_orderedCompare(void)
+{
+    corto_uint64 items[8];
+    corto_uint32 ranks[8], defined[2][8], i, w;
+    test_order orders[2];
+    test_rank rank = {items, ranks};
+    corto_depresolver_opt opt;
+    corto_depresolver resolver;
+    int result = 0;
+
+    memset(defined, 0, sizeof(defined));
+    for (i = 0; i < 8; i ++) {
+        ranks[i] = (3 * i) % 8;
+    }
+    for (w = 0; w < 2; w ++) {
+        orders[w].items = items;
+        orders[w].defined = defined[w];
+        orders[w].count = 0;
+    }
+
+    corto_depresolver_opt_init(&opt);
+    opt.onDeclare = test_onOrderDeclare;
+    opt.onDefine = test_onOrderDefine;
+    opt.userData = &orders[0];
+    opt.flags = CORTO_DEPRESOLVER_ORDERED;
+    opt.compare = test_compareRank;
+    opt.keyData = &rank;
+    resolver = corto_depresolverCreateGeneric(&opt);
+
+    for (i = 0; i < 8; i ++) {
+        corto_depresolver_insert(resolver, &items[i]);
+    }
+
+    for (w = 0; w < 2; w ++) {
+        if (w) {
+            corto_depresolver_setActions(resolver,
+                test_onOrderDeclare, test_onOrderDefine, &orders[w]);
+        }
+        if (corto_depresolver_walk(resolver)) {
+            ut_error("orderedCompare: walk failed");
+            result = -1;
+            break;
+        }
+        for (i = 0; i < 8; i ++) {
+            if (orders[w].count != 8 || defined[w][i] != (3 * i) % 8) {
+                ut_error("orderedCompare: walk %u is not in order of rank", w);
+                result = -1;
+                break;
+            }
+        }
+    }
+
+    corto_depresolver_free(resolver);
+
+    return result;
+}
+
+/* Name with control characters, to check escaping in exported graphs */
+static
+char* test_controlName(
+    void *item,
+    void *keyData)
+{
+    return ut_asprintf("item\t%u\n", test_index(keyData, item));
+}
+
+/* Count occurrences of string in text */
+static
+corto_uint32 test_count(
+    const char *text,
+    const char *str)
+{
+    corto_uint32 result = 0;
+    const char *ptr = text;
+
+    while ((ptr = strstr(ptr, str))) {
+        result ++;
+        ptr += strlen(str);
+    }
+
+    return result;
+}
+
+/* Find node of item in DOT export. Nodes are numbered by the resolver. */
+static
+corto_uint32 test_dotNode(
+    const char *dot,
+    corto_uint32 item)
+{
+    char *label = ut_asprintf(" [label=\"item%u\\n", item);
+    const char *ptr = strstr(dot, label);
+    corto_uint32 result = (corto_uint32)-1;
+
+    if (ptr) {
+        while (ptr > dot && ptr[-1] != '\n') {
+            ptr --;
+        }
+        sscanf(ptr, " n%u", &result);
+    }
+    corto_dealloc(label);
+
+    return result;
+}
+
+/* Item 1 has a weak dependency on item 0, which depends on item 1, so the
+ * weak dependency is broken. Item 2 is declared after item 0 is defined. The
+ * statistics count each kind of dependency, and the DOT export marks the
+ * broken dependency. */
+static
+int test_export(void)
+{
+    corto_depresolver_opt opt;
+    corto_depresolver resolver;
+    corto_depresolver_stats_t stats;
+    test_graph graph;
+    char *dot, *json, *edge;
+    int result;
+
+    test_graphInit(&graph, 3);
+    corto_depresolver_opt_init(&opt);
+    opt.onDeclare = test_onDeclare;
+    opt.onDefine = test_onDefine;
+    opt.userData = &graph;
+    opt.name = test_controlName;
+    opt.keyData = &graph;
+    resolver = corto_depresolverCreateGeneric(&opt);
+
+    test_depend(&graph, resolver, 0, CORTO_VALID, 1, CORTO_VALID);
+    test_depend(&graph, resolver,
+        1, CORTO_VALID, 0, CORTO_DECLARED | CORTO_VALID);
+    test_depend(&graph, resolver, 2, CORTO_DECLARED, 0, CORTO_VALID);
+
+    result = test_walk(&graph, resolver, "export", -1);
+
+    corto_depresolver_stats(resolver, &stats);
+    if (!result && (stats.items != 3 || stats.declareEdges != 1 ||
+        stats.defineEdges != 2 || stats.weakEdges != 1 ||
+        stats.brokenEdges != 1))
+    {
+        ut_error("export: %u items, %u declare, %u define, %u weak and %u "
+            "broken dependencies", stats.items, stats.declareEdges,
+            stats.defineEdges, stats.weakEdges, stats.brokenEdges);
+        result = -1;
+    }
+
+    /* Only the broken dependency is red, as all items are defined */
+    dot = corto_depresolver_toDot(resolver);
+    edge = ut_asprintf(
+        "n%u -> n%u [label=\"DECLARED|VALID -> VALID\", style=dashed, "
+        "color=red];", test_dotNode(dot, 0), test_dotNode(dot, 1));
+    if (!result && (test_count(dot, "color=red") != 1 || !strstr(dot, edge))) {
+        ut_error("export: broken dependency is not marked:\n%s", dot);
+        result = -1;
+    }
+
+    /* DOT has no escapes for control characters, JSON does */
+    json = corto_depresolver_toJson(resolver);
+    if (!result && (!strstr(dot, "[label=\"item0\\n") ||
+        strchr(dot, '\t') || !strstr(json, "\"name\":\"item\\u00090\\u000a\"")))
+    {
+        ut_error("export: names are not escaped:\n%s%s", dot, json);
+        result = -1;
+    }
+
+    corto_dealloc(edge);
+    corto_dealloc(dot);
+    corto_dealloc(json);
+    corto_depresolver_free(resolver);
+    test_graphDeinit(&graph);
+
+    return result;
+}
+
+/* Check analysis against known levels and costs. The widest level and the
+ * parallelism follow from the widths, work and critical path. */
+static
+int test_analyzeCheck(
+    const char *name,
+    corto_depresolver_analysis_t *analysis,
+    const corto_uint32 *width,
+    corto_uint32 depth,
+    double work,
+    double criticalPath)
+{
+    corto_uint32 i, events = 0, maxWidth = 0;
+
+    if (analysis->depth != depth) {
+        ut_error("%s: depth is %u, expected %u", name, analysis->depth, depth);
+        return -1;
+    }
+
+    for (i = 0; i < depth; i ++) {
+        if (analysis->width[i] != width[i]) {
+            ut_error("%s: level %u has %u events, expected %u",
+                name, i, analysis->width[i], width[i]);
+            return -1;
+        }
+        events += width[i];
+        if (width[i] > maxWidth) {
+            maxWidth = width[i];
+        }
+    }
+
+    if (analysis->events != events || analysis->maxWidth != maxWidth ||
+        analysis->unresolved)
+    {
+        ut_error("%s: %u events, max width %u, %u unresolved", name,
+            analysis->events, analysis->maxWidth, analysis->unresolved);
+        return -1;
+    }
+
+    if (analysis->work != work || analysis->criticalPath != criticalPath ||
+        analysis->parallelism != work / criticalPath)
+    {
+        ut_error("%s: work %f, critical path %f, parallelism %f", name,
+            analysis->work, analysis->criticalPath, analysis->parallelism);
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Declare of each item depends on define of the previous item, so every
+ * event is in its own level and workers cannot speed up printing. */
+static
+int test_analyzeChain(void)
+{
+    corto_uint32 count = 8, width[16], i;
+    corto_depresolver resolver;
+    corto_depresolver_analysis_t analysis;
+    test_graph graph;
+    int result;
+
+    test_graphInit(&graph, count);
+    resolver = test_create(&graph, 0, 0, NULL);
+    corto_depresolver_insert(resolver, &graph.items[0]);
+    for (i = 1; i < count; i ++) {
+        test_depend(&graph, resolver, i, CORTO_DECLARED, i - 1, CORTO_VALID);
+    }
+    for (i = 0; i < 2 * count; i ++) {
+        width[i] = 1;
+    }
+
+    corto_depresolver_analyze(resolver, NULL, NULL, &analysis);
+    result = test_analyzeCheck("analyzeChain", &analysis, width, 2 * count,
+        2 * count, 2 * count);
+    if (!result && (corto_depresolver_speedup(&analysis, 1) != 1 ||
+        corto_depresolver_speedup(&analysis, 4) != 1))
+    {
+        ut_error("analyzeChain: speedup of chain is not 1");
+        result = -1;
+    }
+    if (graph.position) {
+        ut_error("analyzeChain: analysis invoked callbacks");
+        result = -1;
+    }
+
+    corto_depresolver_analysis_deinit(&analysis);
+    corto_depresolver_free(resolver);
+    test_graphDeinit(&graph);
+
+    return result;
+}
+
+/* Item 0 and then items 1..count - 1, which depend on item 0, in parallel */
+static
+corto_depresolver test_analyzeFanout(
+    test_graph *graph,
+    corto_uint32 count)
+{
+    corto_depresolver resolver;
+    corto_uint32 i;
+
+    test_graphInit(graph, count);
+    resolver = test_create(graph, 0, 0, NULL);
+    for (i = 1; i < count; i ++) {
+        test_depend(graph, resolver, i, CORTO_DECLARED, 0, CORTO_VALID);
+    }
+
+    return resolver;
+}
+
+/* Declares and defines of the items that depend on item 0 each form a level.
+ * The speedup is limited by the number of workers, and then by the four
+ * levels of the critical path. */
+static
+int test_analyzeWidth(void)
+{
+    corto_uint32 width[] = {1, 1, 6, 6};
+    corto_depresolver resolver;
+    corto_depresolver_analysis_t analysis;
+    test_graph graph;
+    int result;
+
+    resolver = test_analyzeFanout(&graph, 7);
+    corto_depresolver_analyze(resolver, NULL, NULL, &analysis);
+    result = test_analyzeCheck("analyzeWidth", &analysis, width, 4, 14, 4);
+    if (!result && (corto_depresolver_speedup(&analysis, 0) != 1 ||
+        corto_depresolver_speedup(&analysis, 2) != 2 ||
+        corto_depresolver_speedup(&analysis, 16) != 3.5))
+    {
+        ut_error("analyzeWidth: speedup is %f with 2 and %f with 16 workers",
+            corto_depresolver_speedup(&analysis, 2),
+            corto_depresolver_speedup(&analysis, 16));
+        result = -1;
+    }
+
+    corto_depresolver_analysis_deinit(&analysis);
+    corto_depresolver_free(resolver);
+    test_graphDeinit(&graph);
+
+    return result;
+}
+
+/* Item 1 is defined before item 0, which it has a weak dependency on. The
+ * broken dependency does not make the define of item 1 wait for item 0. */
+static
+int test_analyzeCycle(void)
+{
+    corto_uint32 width[] = {2, 1, 1};
+    corto_depresolver resolver;
+    corto_depresolver_analysis_t analysis;
+    corto_depresolver_stats_t stats;
+    test_graph graph;
+    int result;
+
+    test_graphInit(&graph, 2);
+    resolver = test_create(&graph, 0, 0, NULL);
+    test_depend(&graph, resolver, 0, CORTO_VALID, 1, CORTO_VALID);
+    test_depend(&graph, resolver,
+        1, CORTO_VALID, 0, CORTO_DECLARED | CORTO_VALID);
+
+    corto_depresolver_analyze(resolver, NULL, NULL, &analysis);
+    result = test_analyzeCheck("analyzeCycle", &analysis, width, 3, 4, 3);
+
+    corto_depresolver_stats(resolver, &stats);
+    if (!result && stats.brokenEdges != 1) {
+        ut_error("analyzeCycle: broke %u dependencies, expected 1",
+            stats.brokenEdges);
+        result = -1;
+    }
+
+    corto_depresolver_analysis_deinit(&analysis);
+    corto_depresolver_free(resolver);
+    test_graphDeinit(&graph);
+
+    return result;
+}
+
+/* Declares cost 1, and the define of item i costs i + 1 */
+static
+double test_analyzeCost(
+    void *item,
+    corto_state kind,
+    void *userData)
+{
+    return kind == CORTO_VALID ? test_index(userData, item) + 1 : 1;
+}
+
+/* The critical path goes through the most expensive define, not through the
+ * most events */
+static
+int test_analyzeCritical(void)
+{
+    corto_uint32 width[] = {1, 1, 4, 4};
+    corto_depresolver resolver;
+    corto_depresolver_analysis_t analysis;
+    test_graph graph;
+    int result;
+
+    /* Work is 5 declares and defines of cost 1 to 5. The critical path is
+     * the declares of items 0 and 4, and their defines of cost 1 and 5. */
+    resolver = test_analyzeFanout(&graph, 5);
+    corto_depresolver_analyze(resolver, test_analyzeCost, &graph, &analysis);
+    result = test_analyzeCheck("analyzeCritical", &analysis, width, 4, 20, 8);
+    if (!result && corto_depresolver_speedup(&analysis, 2) != 2) {
+        ut_error("analyzeCritical: speedup with 2 workers is %f",
+            corto_depresolver_speedup(&analysis, 2));
+        result = -1;
+    }
+
+    corto_depresolver_analysis_deinit(&analysis);
+    corto_depresolver_free(resolver);
+    test_graphDeinit(&graph);
+
+    return result;
+}
+
+static test_case tests[] = {
+    {"cycles", test_cyclesPlain},
+    {"orderedCycles", test_cyclesOrdered},
+    {"minimalCycles", test_cyclesMinimal},
+    {"orderedMinimalCycles", test_cyclesOrderedMinimal},
+    {"workers", test_cyclesWorkers},
+    {"deepCycle", test_deepCycle},
+    {"unresolvable", test_unresolvable},
+    {"refreeze", test_refreeze},
+    {"update", test_update},
+    {"updateOrdered", test_updateOrdered},
+    {"updateWorkers", test_updateWorkers},
+    {"saveLoad", test_saveLoad},
+    {"reduce", test_reduce},
+    {"reduceRoot", test_reduceRoot},
+    {"reduceChain", test_reduceChain},
+    {"orderedCompare", test_orderedCompare},
+    {"export", test_export},
+    {"analyzeChain", test_analyzeChain},
+    {"analyzeWidth", test_analyzeWidth},
+    {"analyzeCycle", test_analyzeCycle},
+    {"analyzeCritical", test_analyzeCritical},
+    {"anonymousOrder", test_genAnonymousOrder},
+    {"refs", test_genRefs},
+    {"refsFallback", test_genRefsFallback},
+    {"genWorkers", test_genWorkers},
+    {"anonymousIntern", test_genAnonymousIntern},
+    {"walkMulti", test_genWalkMulti},
+    {"walkAll", test_genWalkAll}
+};
+
+int main(int argc, char *argv[]) {
+    const char *filter = argc > 1 ? argv[1] : NULL;
+    corto_uint32 i, failed = 0;
+
+    corto_start(argv[0]);
+
+    for (i = 0; i < sizeof(tests) / sizeof(test_case); i ++) {
+        if (filter && strcmp(filter, tests[i].name)) {
+            continue;
+        }
+        if (tests[i].run()) {
+            printf("FAIL %s\n", tests[i].name);
+            failed ++;
+        } else {
+            printf("PASS %s\n", tests[i].name);
+        }
+    }
+
+    corto_stop();
+
+    return failed ? -1 : 0;
+}